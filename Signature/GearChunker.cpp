@@ -0,0 +1,61 @@
+#include "GearChunker.h"
+#include <array>
+#include <cassert>
+
+namespace {
+
+// Table of random values of bytes generated by SplitMix64, so it is the same in every build
+const std::array<uint64_t, 256> GEAR = [] {
+    std::array<uint64_t, 256> table;
+    uint64_t state = 0;
+    for (auto& value : table) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}();
+
+// High bits of the hash depend on the whole window, so masks take the given number of them
+uint64_t HighBits(unsigned bits)
+{
+    return ~0ULL << (64 - bits);
+}
+
+} // namespace
+
+GearChunker::GearChunker(uint32_t minSize, uint32_t avgSize, uint32_t maxSize) :
+    minSize(minSize), avgSize(avgSize), maxSize(maxSize)
+{
+    assert(minSize > 0 && minSize < avgSize && avgSize < maxSize && (avgSize & (avgSize - 1)) == 0);
+    unsigned bits = 0;
+    while ((1U << bits) < avgSize) ++bits;
+    maskS = HighBits(bits + 2);
+    maskL = HighBits(bits - 2);
+}
+
+uint64_t GearChunker::Cut(const unsigned char* data, uint64_t start, uint64_t end) const
+{
+    if (end - start <= minSize) return end;
+    const uint64_t limit = (end - start > maxSize) ? start + maxSize : end;
+    const uint64_t normal = (limit - start > avgSize) ? start + avgSize : limit;
+
+    // Position i is the last byte of the chunk. The window before the first position
+    // that can end a chunk is hashed first, so the hash does not depend on the start.
+    uint64_t i = start + minSize - 1;
+    uint64_t h = 0;
+    for (uint64_t j = (i >= WINDOW - 1) ? i - (WINDOW - 1) : 0; j < i; ++j) {
+        h = (h << 1) + GEAR[data[j]];
+    }
+
+    for (; i + 1 < normal; ++i) {
+        h = (h << 1) + GEAR[data[i]];
+        if (!(h & maskS)) return i + 1;
+    }
+    for (; i + 1 < limit; ++i) {
+        h = (h << 1) + GEAR[data[i]];
+        if (!(h & maskL)) return i + 1;
+    }
+    return limit;
+}
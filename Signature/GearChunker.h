@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// GearChunker cuts data to chunks at content-defined boundaries as FastCDC does,
+// so an insertion or a removal changes only the chunks around it. Gear hash of a
+// position is a sum of the table values of the 64 bytes up to it shifted by their
+// distance, so it does not depend on where hashing started. A boundary is put after
+// a position which hash has all the mask bits clear. Normalized chunking uses a
+// stricter mask before the average size and a looser one after it, which narrows
+// the distribution of chunk sizes. Bytes before the minimum size are skipped.
+class GearChunker
+{
+public:
+    static const size_t WINDOW = 64;    // Number of bytes the hash of a position depends on
+
+    // Average size must be a power of two between the minimum and the maximum
+    GearChunker(uint32_t minSize, uint32_t avgSize, uint32_t maxSize);
+
+    // Returns the end of the chunk that starts at the given offset of the data of the given size
+    uint64_t Cut(const unsigned char* data, uint64_t start, uint64_t end) const;
+
+private:
+    uint32_t minSize;
+    uint32_t avgSize;
+    uint32_t maxSize;
+    uint64_t maskS;     // Mask before the average size
+    uint64_t maskL;     // Mask after the average size
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <sha256.h>
+#include <sha512.h>
+#include "xxhash/xxhash.h"
+#include "blake3/blake3.h"
+#include "crc32c/crc32c.h"
+
+// Hashers adapt hash implementations to the hashing pipeline of the signature
+// generator, which is specialized for every hasher at compile time:
+//   OUTPUT_SIZE  size of a block hash record in the signature
+//   Lanes()      number of blocks that are worth hashing at once
+//   Hash()       computes hashes of count blocks of equal length, hashers that
+//                can split a block use up to threads threads for every block
+
+// SHA-256 hashes several blocks in parallel lanes of the SIMD implementation
+struct Sha256Hasher
+{
+    static const size_t OUTPUT_SIZE = CSHA256::OUTPUT_SIZE;
+
+    static size_t Lanes() {
+        return SHA256MultiLanes();
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        SHA256Multi(outputs, inputs, count, len);
+    }
+};
+
+// SHA-512 and SHA-512/256 hash several blocks in parallel lanes of the SIMD implementation
+struct Sha512Hasher
+{
+    static const size_t OUTPUT_SIZE = CSHA512::OUTPUT_SIZE;
+
+    static size_t Lanes() {
+        return SHA512MultiLanes();
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        SHA512Multi(outputs, inputs, count, len);
+    }
+};
+
+struct Sha512_256Hasher
+{
+    static const size_t OUTPUT_SIZE = CSHA512_256::OUTPUT_SIZE;
+
+    static size_t Lanes() {
+        return SHA512MultiLanes();
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        SHA512_256Multi(outputs, inputs, count, len);
+    }
+};
+
+// XXH64 is a fast non-cryptographic hash for integrity checks, stored in big endian
+struct XXH64Hasher
+{
+    static const size_t OUTPUT_SIZE = sizeof(XXH64_hash_t);
+
+    static size_t Lanes() {
+        return 1;
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        for (size_t i = 0; i < count; ++i) {
+            XXH64_canonicalFromHash(outputs[i], XXH64(inputs[i], len, 0));
+        }
+    }
+};
+
+// BLAKE3 hashes chunks of a block in parallel SIMD lanes. Its tree structure
+// allows splitting a large block between threads when blocks are fewer than cores.
+struct Blake3Hasher
+{
+    static const size_t OUTPUT_SIZE = BLAKE3_OUT_LEN;
+
+    static size_t Lanes() {
+        return 1;
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        for (size_t i = 0; i < count; ++i) {
+            BLAKE3Hash(outputs[i], inputs[i], len, threads);
+        }
+    }
+};
+
+// XXH3-128 is a fast non-cryptographic hash for integrity checks, stored in big endian
+struct XXH3Hasher
+{
+    static const size_t OUTPUT_SIZE = sizeof(XXH128_hash_t);
+
+    static size_t Lanes() {
+        return 1;
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        for (size_t i = 0; i < count; ++i) {
+            XXH128_canonicalFromHash(outputs[i], XXH3_128bits(inputs[i], len));
+        }
+    }
+};
+
+// CRC-32C uses the crc32 instruction when the CPU supports it, stored in big endian
+struct Crc32cHasher
+{
+    static const size_t OUTPUT_SIZE = CRC32C_OUT_LEN;
+
+    static size_t Lanes() {
+        return 1;
+    }
+
+    static void Hash(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len, unsigned threads) {
+        for (size_t i = 0; i < count; ++i) {
+            CRC32C_canonicalFromHash(outputs[i], CRC32C(inputs[i], len));
+        }
+    }
+};
@@ -0,0 +1,88 @@
+#include "MerkleTree.h"
+#include <sha256.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+MerkleTree::MerkleTree(uint64_t leaves, Sink sink) : sink(sink)
+{
+    assert(leaves > 0);
+    levelSizes.push_back(leaves);
+    while (levelSizes.back() > 1) {
+        levelSizes.push_back((levelSizes.back() + 1) / 2);
+    }
+    levels.resize(levelSizes.size());
+}
+
+uint64_t MerkleTree::LevelOffset(size_t level) const
+{
+    uint64_t offset = 0;
+    for (size_t i = 0; i < level; ++i) offset += levelSizes[i] * NODE_SIZE;
+    return offset;
+}
+
+uint64_t MerkleTree::LeavesOf(uint64_t size)
+{
+    // Size grows with the number of leaves, so the number is found by a binary search
+    if (size < NODE_SIZE) return 0;
+    uint64_t low = 1, high = size / NODE_SIZE;
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        if (MerkleTree(middle, nullptr).Size() < size) low = middle + 1;
+        else high = middle;
+    }
+    return MerkleTree(low, nullptr).Size() == size ? low : 0;
+}
+
+void MerkleTree::Add(const unsigned char leaf[NODE_SIZE])
+{
+    Push(0, leaf, 1);
+}
+
+void MerkleTree::Finish(unsigned char root[NODE_SIZE])
+{
+    // Levels are completed from the leaves up, so every level has all its nodes when it is reached
+    for (size_t level = 0; level + 1 < levels.size(); ++level) {
+        auto& pending = levels[level].pending;
+        Combine(level, pending.size() / (2 * NODE_SIZE));
+        if (!pending.empty()) {
+            // Odd last node has no pair, so it becomes the last node of the next level
+            unsigned char last[NODE_SIZE];
+            memcpy(last, pending.data(), NODE_SIZE);
+            pending.clear();
+            Push(level + 1, last, 1);
+        }
+    }
+
+    const auto& top = levels.back().pending;
+    assert(top.size() == NODE_SIZE);
+    memcpy(root, top.data(), NODE_SIZE);
+}
+
+void MerkleTree::Push(size_t level, const unsigned char* nodes, size_t count)
+{
+    // Leaves are stored by the caller, the levels above are passed to the sink as they are completed
+    if (level > 0) {
+        sink(level, levels[level].emitted, nodes, count);
+        levels[level].emitted += count;
+    }
+
+    auto& pending = levels[level].pending;
+    pending.insert(pending.end(), nodes, nodes + count * NODE_SIZE);
+    if (level + 1 < levels.size() && pending.size() >= 2 * BATCH_PAIRS * NODE_SIZE) {
+        Combine(level, BATCH_PAIRS);
+    }
+}
+
+void MerkleTree::Combine(size_t level, size_t pairs)
+{
+    auto& pending = levels[level].pending;
+    while (pairs > 0) {
+        const size_t count = (std::min)(pairs, BATCH_PAIRS);
+        std::vector<unsigned char> parents(count * NODE_SIZE);
+        SHA256D64(parents.data(), pending.data(), count);
+        pending.erase(pending.begin(), pending.begin() + count * 2 * NODE_SIZE);
+        pairs -= count;
+        Push(level + 1, parents.data(), count);
+    }
+}
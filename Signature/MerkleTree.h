@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+// MerkleTree builds a binary hash tree over 32-byte leaves that arrive in order.
+// Interior nodes are double SHA-256 of the concatenation of two children. An odd
+// last node of a level is promoted to the next level unchanged, because pairing it
+// with itself as in Bitcoin gives leaves [A,B,C] and [A,B,C,C] the same root. Pairs
+// are hashed in batches with SHA256D64 as soon as enough of them are complete, and
+// the finished nodes of every level are passed to the sink, which may store them at
+// their offsets.
+class MerkleTree
+{
+public:
+    static const size_t NODE_SIZE = 32;
+
+    // Receives count consecutive nodes of the level starting from the node with the given index
+    typedef std::function<void(size_t level, uint64_t index, const unsigned char* nodes, size_t count)> Sink;
+
+    MerkleTree(uint64_t leaves, Sink sink);
+
+    // Number of levels including the leaves and the root
+    size_t Levels() const {
+        return levelSizes.size();
+    }
+
+    // Number of nodes of the level, level 0 are the leaves
+    uint64_t LevelSize(size_t level) const {
+        return levelSizes[level];
+    }
+
+    // Offset of the level in the serialized tree where levels follow each other from the leaves to the root
+    uint64_t LevelOffset(size_t level) const;
+
+    // Size of the serialized tree in bytes
+    uint64_t Size() const {
+        return LevelOffset(Levels());
+    }
+
+    // Number of leaves of the tree of the given serialized size, zero if no tree has this size
+    static uint64_t LeavesOf(uint64_t size);
+
+    // Adds the next leaf
+    void Add(const unsigned char leaf[NODE_SIZE]);
+
+    // Completes the tree after the last leaf and returns its root
+    void Finish(unsigned char root[NODE_SIZE]);
+
+private:
+    static const size_t BATCH_PAIRS = 256;  // Number of pairs hashed at once
+
+    struct Level
+    {
+        std::vector<unsigned char> pending; // Nodes which parents are not computed yet
+        uint64_t emitted = 0;               // Number of nodes passed to the sink
+    };
+
+    std::vector<uint64_t> levelSizes;
+    std::vector<Level> levels;
+    Sink sink;
+
+    void Push(size_t level, const unsigned char* nodes, size_t count);
+    void Combine(size_t level, size_t pairs);
+};
@@ -1,7 +1,154 @@
 #pragma once
 #include <queue>
 #include <mutex>
-#include <boost/interprocess/sync/named_semaphore.hpp>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cassert>
+#include <stdexcept>
+#include <condition_variable>
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+// RingBuffer class is a lock-free bounded queue for multiple producers and
+// multiple consumers. Every cell has a sequence number that tells whether
+// the cell is ready to be written or read at the given position, so threads
+// only compete on the head and tail positions. Cells and positions are
+// padded to the cache line size to avoid false sharing. Capacity is rounded
+// up to a power of two. TryPush and TryPop never block.
+template<typename T>
+class RingBuffer
+{
+private:
+    struct alignas(CACHE_LINE_SIZE) Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail = 0;     // Position to push to
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head = 0;     // Position to pop from
+
+public:
+
+    void Init(size_t minCapacity) {
+        assert(minCapacity > 0);
+        size_t capacity = 1;
+        while (capacity < minCapacity) capacity <<= 1;
+        cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask = capacity - 1;
+        tail.store(0, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+    }
+
+    bool TryPush(T item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(item);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false; // Full
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T& item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(cell.data);
+                    cell.data = T();
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false; // Empty or the item is not published yet
+            }
+            else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// Semaphore class is an in-process counting semaphore. Wait spins for a
+// short time and only then goes to sleep, so when the count is positive
+// no lock is taken at all.
+class Semaphore
+{
+private:
+    static const int SPIN_COUNT = 1024;
+
+    std::atomic<int64_t> count;     // Negative value is the number of sleeping waiters
+    std::mutex waitMutex;
+    std::condition_variable cv;
+    int64_t wakeups = 0;
+
+    bool TryAcquire() {
+        int64_t current = count.load(std::memory_order_relaxed);
+        while (current > 0) {
+            if (count.compare_exchange_weak(current, current - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+
+    explicit Semaphore(int64_t initialCount = 0) : count(initialCount) {
+        assert(initialCount >= 0);
+    }
+
+    bool TryWait() {
+        return TryAcquire();
+    }
+
+    void Wait() {
+        for (int i = 0; i < SPIN_COUNT; ++i) {
+            if (TryAcquire()) return;
+        }
+
+        if (count.fetch_sub(1, std::memory_order_acquire) > 0) return;
+
+        std::unique_lock<std::mutex> lock(waitMutex);
+        cv.wait(lock, [this] { return wakeups > 0; });
+        --wakeups;
+    }
+
+    void Signal(int64_t n = 1) {
+        const int64_t old = count.fetch_add(n, std::memory_order_release);
+        const int64_t toWake = (old < 0) ? (std::min)(-old, n) : 0;
+        if (toWake > 0) {
+            {
+                std::lock_guard<std::mutex> lock(waitMutex);
+                wakeups += toWake;
+            }
+            for (int64_t i = 0; i < toWake; ++i) cv.notify_one();
+        }
+    }
+};
 
 // Pool class allows to create a pool of objects that can be allocated
 // and released when needed. It is thread safe. It does not have
@@ -37,64 +184,121 @@ public:
 // and released when needed. Allocate operation is blocking and waits until
 // an object is available. It is thread safe. Quantity of objects must
 // be defined. Objects must be created with std::make_shared and added to
-// the pool via Release method.
+// the pool via Release method. Pool does not use named system objects,
+// so any number of pools can exist in any number of processes.
 template<typename T>
 class SyncPool
 {
 private:
-    std::queue<std::shared_ptr<T>> items;
-    std::mutex poolMutex;
-    std::string sName;
-    unsigned int itemsCount = 0;
+    RingBuffer<std::shared_ptr<T>> items;
+    Semaphore available;
+    std::atomic<unsigned int> itemsCount = 0;
     unsigned int maxItems = 0;
     bool isInit = false;
 
 public:
 
-    ~SyncPool() {
-        boost::interprocess::named_semaphore::remove(sName.c_str());
-    }
-
-    void Init(std::string semaphoreName, unsigned int initialCount) {
-        assert(semaphoreName != "");
+    void Init(unsigned int initialCount) {
         assert(initialCount > 0);
-        sName = semaphoreName;
         itemsCount = 0;
         maxItems = initialCount;
-        boost::interprocess::named_semaphore::remove(sName.c_str());
-        boost::interprocess::named_semaphore semaphore(boost::interprocess::create_only_t(), sName.c_str(), initialCount);
-        for (unsigned int i = 0; i < initialCount; i++) {
-            semaphore.wait(); // Lock allocation while pool is empty
-        }
+        items.Init(initialCount);
         isInit = true;
     }
 
     std::shared_ptr<T> Allocate() {
         assert(isInit);
-        boost::interprocess::named_semaphore semaphore(boost::interprocess::open_only_t(), sName.c_str());
-        semaphore.wait();
-        std::shared_ptr<T> item;
-        std::lock_guard<std::mutex> lock(poolMutex);
-        if (!items.empty())
-        {
-            item = items.front();
-            items.pop();
-        }
+        available.Wait();
         itemsCount--;
+        std::shared_ptr<T> item;
+        // Released item may be counted before it is published in the ring
+        while (!items.TryPop(item)) std::this_thread::yield();
         return item;
     }
 
     void Release(std::shared_ptr<T> item) {
         assert(isInit);
-        boost::interprocess::named_semaphore semaphore(boost::interprocess::open_only_t(), sName.c_str());
-        std::lock_guard<std::mutex> lock(poolMutex);
-        itemsCount++;
-        if (itemsCount > maxItems) throw std::runtime_error("SyncPool class exception. Pool is overwhelmed with number of items that can be controlled by semaphore");
-        items.push(item);
-        semaphore.post();
+        if (++itemsCount > maxItems || !items.TryPush(std::move(item))) {
+            throw std::runtime_error("SyncPool class exception. Pool is overwhelmed with number of items that can be controlled by semaphore");
+        }
+        available.Signal();
     }
 
     const unsigned int GetMaxItems() {
         return maxItems;
     }
-};
\ No newline at end of file
+};
+
+// SyncQueue class is a bounded FIFO queue for passing objects between threads.
+// Objects are kept in a lock-free RingBuffer, semaphores count queued objects
+// and free slots. Push blocks while the queue is full and Pop blocks while it
+// is empty, so idle consumers sleep instead of polling. Every Push wakes up
+// at most one consumer. Close must be called after the last Push. Then Pop
+// returns remaining objects and after that returns false to signal consumers
+// that no more objects will come.
+template<typename T>
+class SyncQueue
+{
+private:
+    RingBuffer<T> items;
+    Semaphore queued;
+    Semaphore freeSlots;
+    std::atomic<bool> closed = false;
+
+public:
+
+    void Init(size_t maxItems) {
+        assert(maxItems > 0);
+        items.Init(maxItems);
+        freeSlots.Signal(static_cast<int64_t>(maxItems));
+    }
+
+    void Push(T item) {
+        freeSlots.Wait();
+        // Slot may be counted as free before the consumer releases it in the ring
+        while (!items.TryPush(item)) std::this_thread::yield();
+        queued.Signal();
+    }
+
+    bool Pop(T& item) {
+        queued.Wait();
+        for (;;) {
+            if (items.TryPop(item)) {
+                freeSlots.Signal();
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                queued.Signal(); // Pass the wake up to the next consumer
+                return false;
+            }
+            std::this_thread::yield(); // Object is counted but not published yet
+        }
+    }
+
+    // Takes an object only if it is available without waiting
+    bool TryPop(T& item) {
+        if (!queued.TryWait()) return false;
+        for (;;) {
+            if (items.TryPop(item)) {
+                freeSlots.Signal();
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                queued.Signal(); // Pass the wake up to the next consumer
+                return false;
+            }
+            std::this_thread::yield(); // Object is counted but not published yet
+        }
+    }
+
+    void Close() {
+        closed.store(true, std::memory_order_release);
+        queued.Signal();
+    }
+
+    // Makes the queue usable again after all the consumers have got false from Pop
+    void Reopen() {
+        queued.Wait(); // Wake up passed on by the last consumer
+        closed.store(false, std::memory_order_release);
+    }
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+
+// ReorderWindow class allows to pass items produced out of order to a consumer
+// that takes them strictly in order of their numbers. It is a circular buffer
+// of a fixed size, so memory does not depend on the quantity of items. Item
+// with number N occupies slot N % size. The slot becomes free for item N + size
+// as soon as item N is taken, so producers can not run ahead of the consumer
+// by more than the window size. Closing the window releases all the waiting
+// threads, so producers and the consumer can stop before the last item.
+template<typename T>
+class ReorderWindow
+{
+private:
+    struct Slot
+    {
+        std::mutex mx;
+        std::condition_variable cv;
+        uint64_t number = 0;    // Number of the item the slot is awaiting
+        bool ready = false;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t size = 0;
+    std::atomic<bool> closed = false;
+
+    Slot& SlotOf(uint64_t number) {
+        return slots[static_cast<size_t>(number % size)];
+    }
+
+public:
+
+    void Init(size_t windowSize, uint64_t first = 0) {
+        assert(windowSize > 0);
+        size = windowSize;
+        slots.reset(new Slot[size]);
+        Reset(first);
+    }
+
+    // Items are numbered from the first one, every slot awaits the first item that maps to it.
+    // Items put before must be taken or abandoned by closing the window.
+    void Reset(uint64_t first) {
+        const size_t firstSlot = static_cast<size_t>(first % size);
+        for (size_t i = 0; i < size; ++i) {
+            slots[i].number = first + (i + size - firstSlot) % size;
+            slots[i].ready = false;
+        }
+        closed = false;
+    }
+
+    // Releases waiting threads, after that putting and taking items return at once
+    void Close() {
+        closed = true;
+        for (size_t i = 0; i < size; ++i) {
+            std::lock_guard<std::mutex> lock(slots[i].mx);
+            slots[i].cv.notify_all();
+        }
+    }
+
+    // Checks without blocking whether item can be put to the window
+    bool IsSlotFree(uint64_t number) {
+        Slot& slot = SlotOf(number);
+        std::lock_guard<std::mutex> lock(slot.mx);
+        return slot.number == number && !slot.ready;
+    }
+
+    // Waits until item can be put to the window
+    void WaitSlot(uint64_t number) {
+        Slot& slot = SlotOf(number);
+        std::unique_lock<std::mutex> lock(slot.mx);
+        slot.cv.wait(lock, [&] { return slot.number == number || closed; });
+    }
+
+    void Put(uint64_t number, const T& value) {
+        Slot& slot = SlotOf(number);
+        {
+            std::unique_lock<std::mutex> lock(slot.mx);
+            slot.cv.wait(lock, [&] { return (slot.number == number && !slot.ready) || closed; });
+            if (closed) return;
+            slot.value = value;
+            slot.ready = true;
+        }
+        slot.cv.notify_all();
+    }
+
+    // Waits for the item and frees its slot for the item that is the window size ahead
+    T Take(uint64_t number) {
+        Slot& slot = SlotOf(number);
+        T value;
+        {
+            std::unique_lock<std::mutex> lock(slot.mx);
+            slot.cv.wait(lock, [&] { return (slot.number == number && slot.ready) || closed; });
+            if (closed) return value;
+            value = slot.value;
+            slot.ready = false;
+            slot.number += size;
+        }
+        slot.cv.notify_all();
+        return value;
+    }
+};
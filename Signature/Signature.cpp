@@ -3,6 +3,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include "SignatureGenerator.h"
+#include "SignatureIndex.h"
 
 namespace po = boost::program_options;
 
@@ -17,7 +18,34 @@ calculates hashes for each block and writes hashes to output file. By default bl
             ("help", "shows this message")
             ("input,if", po::value<std::string>(), "Input file")
             ("output,of", po::value<std::string>(), "Output file")
-            ("block,bs", po::value<int>(), "Block size in KB");
+            ("block,bs", po::value<int>(), "Block size in KB. By default 1 MB, in verify, update and search modes the block size of the signature")
+            ("reader", po::value<std::string>(), "Input reading mode: stream (default), mmap, pread or async")
+            ("queue-depth", po::value<int>(), "Number of reads in flight for async reading mode. By default 32")
+            ("registered-buffers", "Lock read buffers in memory for async reading mode")
+            ("direct", "Read without file caching in pread and async reading modes")
+            ("algorithm", po::value<std::string>(), "Hash algorithm: sha256 (default), sha512, sha512-256, blake3, xxh64, xxh3 (non-cryptographic) or crc32c (checksum)")
+            ("sha-impl", po::value<std::string>(), "SHA-256 implementation: auto (default), standard, sse4 (builds with the assembly transform), avx2, avx512 or shani. SHA-512 supports auto, standard and avx2")
+            ("weak", "Append the rolling checksum of rsync to every hash record, so the blocks can be found at any offset of another file by search mode")
+            ("merkle", "Append a Merkle tree over the block hashes and write its root to the header. Requires 32-byte hashes: sha256, sha512-256 or blake3")
+            ("raw", "Write the signature as the first version did for existing consumers: plain records for sha256, otherwise an 8-byte header before them. By default the header describes the input file and the records start at a page boundary, so they can be mapped and indexed directly")
+            ("verify", po::value<std::string>(), "Check the input file against the signature instead of generating it. Algorithm and block size are taken from the signature, a given block size must be the same")
+            ("all-mismatches", "Report all mismatching blocks in verify mode instead of stopping at the first one")
+            ("first-block", po::value<uint64_t>(), "Number of the first block to check in verify mode. By default 0")
+            ("last-block", po::value<uint64_t>(), "Number of the last block to check in verify mode. By default the last block of the file")
+            ("update", po::value<std::string>(), "Hash again only the changed blocks of the input file and update its previous signature in place")
+            ("dirty", po::value<std::string>(), "Changed byte ranges of the input file for update mode as offset:length separated by commas. Without it all blocks are hashed if the input file is newer than the signature")
+            ("append-only", "Data was only appended to the input file since the signature was generated, for update mode")
+            ("search", po::value<std::string>(), "Find the blocks of the signature with weak checksums at any offset of the input file, for delta generation. Matches are written to the output file if it is given, as 8-byte offsets in the input file followed by 8-byte block numbers. Block size is taken from the signature. Uses mmap reading mode")
+            ("build-index", po::value<std::string>(), "Build the index of the signature, which finds the blocks or chunks with a hash, and write it to the output file. Input file is not needed")
+            ("index", po::value<std::string>(), "Index of a signature to query with --lookup or --join. Input file is not needed")
+            ("lookup", po::value<std::string>(), "Hexadecimal hashes separated by commas to find in the index. Numbers of the blocks or chunks with every hash are printed")
+            ("join", po::value<std::string>(), "Find the blocks or chunks of the signature which hashes are in the index. Their pairs are written to the output file if it is given, as 8-byte numbers in the signature followed by the 8-byte numbers of the first ones in the index")
+            ("checkpoint", po::value<int>(), "Seconds between checkpoints of the generated signature, which allow resuming it after an interruption. By default 30, 0 disables checkpoints")
+            ("resume", "Continue the generation of the output signature after its last checkpoint. Other options must be the same as for the interrupted generation")
+            ("cdc", "Cut the input file to chunks at content-defined boundaries instead of fixed blocks and write offset, length and hash of every chunk. Blocks are the segments cut in parallel, so they must be at least twice the maximum chunk size. Uses mmap reading mode")
+            ("min-chunk", po::value<int>(), "Minimum chunk size in KB for content-defined chunking. By default 2")
+            ("avg-chunk", po::value<int>(), "Average chunk size in KB for content-defined chunking, a power of two. By default 8")
+            ("max-chunk", po::value<int>(), "Maximum chunk size in KB for content-defined chunking. By default 64");
 
         po::variables_map args;
         po::store(po::parse_command_line(argc, argv, desc), args);
@@ -27,6 +55,13 @@ calculates hashes for each block and writes hashes to output file. By default bl
         std::string inputFilePath = "";
         std::string outputFilePath = "";
         uint64_t blockSize = 0;
+        ReaderSettings reader;
+        HashSettings hashing;
+        OutputSettings output;
+        VerifySettings verify;
+        UpdateSettings update;
+        ChunkingSettings chunking;
+        SearchSettings search;
 
         do {
             if (args.count("help") || args.empty()) {
@@ -34,6 +69,55 @@ calculates hashes for each block and writes hashes to output file. By default bl
                 break;
             }
 
+            // Index commands work with signatures only
+            if (args.count("build-index")) {
+                if (!args.count("output")) {
+                    std::cerr << "Output file is a required parameter" << std::endl;
+                    break;
+                }
+                const uint64_t distinct = SignatureIndex::Build(args["build-index"].as<std::string>(), args["output"].as<std::string>());
+                std::cout << "Distinct hashes: " << distinct << std::endl;
+                break;
+            }
+            if (args.count("index")) {
+                SignatureIndex index(args["index"].as<std::string>());
+                if (args.count("join")) {
+                    const std::string matchesPath = args.count("output") ? args["output"].as<std::string>() : "";
+                    const uint64_t shared = index.Join(args["join"].as<std::string>(), matchesPath);
+                    std::cout << "Shared blocks: " << shared << std::endl;
+                }
+                else if (args.count("lookup")) {
+                    std::stringstream lookupArg(args["lookup"].as<std::string>());
+                    std::string hashArg;
+                    while (std::getline(lookupArg, hashArg, ',')) {
+                        std::vector<unsigned char> hash(index.Header().keySize);
+                        const bool validHash = hashArg.size() == hash.size() * 2 && hashArg.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos;
+                        if (!validHash) {
+                            std::cerr << "Hash must be given as " << hash.size() * 2 << " hexadecimal digits: " << hashArg << std::endl;
+                            errorCode = ERROR_INVALID_DATA;
+                            break;
+                        }
+                        for (size_t i = 0; i < hash.size(); ++i) {
+                            hash[i] = static_cast<unsigned char>(std::stoul(hashArg.substr(2 * i, 2), nullptr, 16));
+                        }
+
+                        const SignatureIndex::Records records = index.Find(hash.data());
+                        std::cout << hashArg << ":";
+                        if (records.count == 0) std::cout << " not found";
+                        for (uint64_t i = 0; i < records.count; ++i) std::cout << " " << records[i];
+                        std::cout << std::endl;
+                    }
+                }
+                else {
+                    std::cerr << "Index is queried with --lookup or --join" << std::endl;
+                }
+                break;
+            }
+            if (args.count("lookup") || args.count("join")) {
+                std::cerr << "Lookup and join require an index" << std::endl;
+                break;
+            }
+
             if (args.count("input")) {
                 inputFilePath = args["input"].as<std::string>();
             }
@@ -47,7 +131,29 @@ calculates hashes for each block and writes hashes to output file. By default bl
                 break;
             }
 
-            if (args.count("output")) {
+            if (args.count("verify") + args.count("update") + args.count("search") > 1) {
+                std::cerr << "Verify, update and search modes can not be used together" << std::endl;
+                break;
+            }
+
+            if (args.count("verify")) {
+                // Signature to check against takes the place of the output file
+                outputFilePath = args["verify"].as<std::string>();
+                verify.enabled = true;
+            }
+            else if (args.count("update")) {
+                // Signature to update takes the place of the output file
+                outputFilePath = args["update"].as<std::string>();
+                update.enabled = true;
+            }
+            else if (args.count("search")) {
+                // Signature to search for takes the place of the output file, which receives the matches
+                outputFilePath = args["search"].as<std::string>();
+                if (args.count("output")) search.matchesPath = args["output"].as<std::string>();
+                search.enabled = true;
+                if (!args.count("reader")) reader.mode = ReadMode::Mapped;
+            }
+            else if (args.count("output")) {
                 outputFilePath = args["output"].as<std::string>();
             }
             else {
@@ -65,14 +171,217 @@ calculates hashes for each block and writes hashes to output file. By default bl
 
                 blockSize = bsArg * KB; // Convert from kylobytes to bytes
             }
+            else if (verify.enabled || update.enabled || search.enabled) {
+                // Block size is taken from the signature header
+                blockSize = 0;
+            }
             else
             {
                 std::cout << "Block size is set to default 1 MB" << std::endl;
-                blockSize = 1 * MB;
+                blockSize = SignatureGenerator::DEFAULT_BLOCK_SIZE;
             }
 
-            SignatureGenerator sg(inputFilePath, outputFilePath, blockSize);
-            sg.Generate();
+            if (args.count("reader")) {
+                std::string readerArg = args["reader"].as<std::string>();
+
+                if (readerArg == "stream") {
+                    reader.mode = ReadMode::Stream;
+                }
+                else if (readerArg == "mmap") {
+                    reader.mode = ReadMode::Mapped;
+                }
+                else if (readerArg == "pread") {
+                    reader.mode = ReadMode::Positional;
+                }
+                else if (readerArg == "async") {
+                    reader.mode = ReadMode::Async;
+                }
+                else {
+                    std::cerr << "Unknown reading mode: " << readerArg << std::endl;
+                    break;
+                }
+            }
+
+            if (args.count("queue-depth")) {
+                int qdArg = args["queue-depth"].as<int>();
+
+                if (qdArg <= 0) {
+                    std::cerr << "Queue depth must be greater than zero" << std::endl;
+                    break;
+                }
+
+                reader.queueDepth = static_cast<uint32_t>(qdArg);
+            }
+
+            reader.registeredBuffers = args.count("registered-buffers") > 0;
+            reader.directIo = args.count("direct") > 0;
+
+            if (args.count("algorithm")) {
+                std::string algorithmArg = args["algorithm"].as<std::string>();
+
+                if (algorithmArg == "sha256") {
+                    hashing.algorithm = HashAlgorithm::Sha256;
+                }
+                else if (algorithmArg == "sha512") {
+                    hashing.algorithm = HashAlgorithm::Sha512;
+                }
+                else if (algorithmArg == "sha512-256") {
+                    hashing.algorithm = HashAlgorithm::Sha512_256;
+                }
+                else if (algorithmArg == "xxh64") {
+                    hashing.algorithm = HashAlgorithm::XXH64;
+                }
+                else if (algorithmArg == "blake3") {
+                    hashing.algorithm = HashAlgorithm::Blake3;
+                }
+                else if (algorithmArg == "xxh3") {
+                    hashing.algorithm = HashAlgorithm::XXH3_128;
+                }
+                else if (algorithmArg == "crc32c") {
+                    hashing.algorithm = HashAlgorithm::CRC32C;
+                }
+                else {
+                    std::cerr << "Unknown hash algorithm: " << algorithmArg << std::endl;
+                    break;
+                }
+            }
+
+            if (args.count("sha-impl")) {
+                std::string implArg = args["sha-impl"].as<std::string>();
+
+                if (implArg == "auto") {
+                    hashing.implementation = sha256_implementation::USE_ALL;
+                }
+                else if (implArg == "standard") {
+                    hashing.implementation = sha256_implementation::STANDARD;
+                }
+                else if (implArg == "sse4") {
+                    hashing.implementation = sha256_implementation::USE_SSE4;
+                }
+                else if (implArg == "avx2") {
+                    hashing.implementation = sha256_implementation::USE_SSE4_AND_AVX2;
+                }
+                else if (implArg == "avx512") {
+                    hashing.implementation = sha256_implementation::USE_SSE4_AND_AVX512;
+                }
+                else if (implArg == "shani") {
+                    hashing.implementation = sha256_implementation::USE_SHANI;
+                }
+                else {
+                    std::cerr << "Unknown SHA implementation: " << implArg << std::endl;
+                    break;
+                }
+            }
+
+            hashing.weakChecksum = args.count("weak") > 0;
+            output.merkleTree = args.count("merkle") > 0;
+
+            if ((verify.enabled || update.enabled || search.enabled) && args.count("raw")) {
+                std::cerr << "Raw layout is supported only when a signature is generated" << std::endl;
+                break;
+            }
+            output.raw = args.count("raw") > 0;
+
+            if ((verify.enabled || update.enabled || search.enabled) && (args.count("checkpoint") || args.count("resume"))) {
+                std::cerr << "Checkpoints are supported only when a signature is generated" << std::endl;
+                break;
+            }
+            if (args.count("checkpoint")) {
+                int checkpointArg = args["checkpoint"].as<int>();
+
+                if (checkpointArg < 0) {
+                    std::cerr << "Checkpoint interval must not be negative" << std::endl;
+                    break;
+                }
+
+                output.checkpointInterval = static_cast<uint32_t>(checkpointArg);
+            }
+            output.resume = args.count("resume") > 0;
+
+            if (!verify.enabled && (args.count("all-mismatches") || args.count("first-block") || args.count("last-block"))) {
+                std::cerr << "Mismatches report and block range are supported only in verify mode" << std::endl;
+                break;
+            }
+            verify.allMismatches = args.count("all-mismatches") > 0;
+            if (args.count("first-block")) {
+                verify.firstBlock = args["first-block"].as<uint64_t>();
+            }
+            if (args.count("last-block")) {
+                verify.lastBlock = args["last-block"].as<uint64_t>();
+            }
+
+            if (!update.enabled && (args.count("dirty") || args.count("append-only"))) {
+                std::cerr << "Changed ranges are supported only in update mode" << std::endl;
+                break;
+            }
+            update.appendOnly = args.count("append-only") > 0;
+            if (args.count("dirty")) {
+                std::stringstream dirtyArg(args["dirty"].as<std::string>());
+                std::string rangeArg;
+                bool validRanges = true;
+                while (validRanges && std::getline(dirtyArg, rangeArg, ',')) {
+                    std::stringstream rs(rangeArg);
+                    uint64_t offset = 0, length = 0;
+                    char separator = 0;
+                    validRanges = (rs >> offset >> separator >> length) && separator == ':';
+                    update.dirtyRanges.emplace_back(offset, length);
+                }
+                if (!validRanges) {
+                    std::cerr << "Changed range must be given as offset:length: " << rangeArg << std::endl;
+                    break;
+                }
+            }
+
+            chunking.enabled = args.count("cdc") > 0;
+            if (!chunking.enabled && (args.count("min-chunk") || args.count("avg-chunk") || args.count("max-chunk"))) {
+                std::cerr << "Chunk sizes are supported only with content-defined chunking" << std::endl;
+                break;
+            }
+            if (chunking.enabled && !args.count("reader")) {
+                reader.mode = ReadMode::Mapped;
+            }
+
+            const char* chunkArgs[] = { "min-chunk", "avg-chunk", "max-chunk" };
+            uint32_t* chunkSizes[] = { &chunking.minSize, &chunking.avgSize, &chunking.maxSize };
+            bool validChunkSizes = true;
+            for (int i = 0; i < 3 && validChunkSizes; ++i) {
+                if (!args.count(chunkArgs[i])) continue;
+                int chunkArg = args[chunkArgs[i]].as<int>();
+                validChunkSizes = chunkArg > 0 && chunkArg <= 1024 * 1024;
+                *chunkSizes[i] = static_cast<uint32_t>(chunkArg * KB);
+            }
+            if (!validChunkSizes) {
+                std::cerr << "Chunk sizes must be from 1 KB to 1 GB" << std::endl;
+                break;
+            }
+
+            SignatureGenerator sg(inputFilePath, outputFilePath, blockSize, reader, hashing, output, verify, update, chunking, search);
+            if (search.enabled) {
+                const uint64_t found = sg.Search();
+                const uint64_t literal = boost::filesystem::file_size(inputFilePath) - found * sg.GetBlockSize();
+                std::cout << std::endl << "Blocks found: " << found << ", bytes not found: " << literal << std::endl;
+                break;
+            }
+            if (update.enabled) {
+                const uint64_t hashed = sg.Update();
+                if (hashed == 0) std::cout << "Signature is up to date" << std::endl;
+                else std::cout << std::endl << "Blocks hashed again: " << hashed << std::endl;
+                break;
+            }
+            if (!verify.enabled) {
+                sg.Generate();
+                break;
+            }
+
+            if (sg.Verify()) {
+                std::cout << std::endl << "Input file matches the signature" << std::endl;
+            }
+            else {
+                std::cout << std::endl << "Input file does not match the signature, mismatching blocks:";
+                for (uint64_t number : sg.GetMismatches()) std::cout << " " << number;
+                std::cout << std::endl;
+                errorCode = ERROR_CRC;
+            }
 
         } while (false);
     }
@@ -0,0 +1,255 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "crc32c/crc32c.h"
+
+// Defines the hash algorithm of blocks. Values are stored in signature headers,
+// so they must not be changed when algorithms are added.
+enum class HashAlgorithm : uint8_t
+{
+    Sha256 = 0,
+    Sha512 = 1,
+    Sha512_256 = 2, // SHA-512 truncated to 256 bits
+    XXH64 = 3,      // Non-cryptographic, for integrity checks only
+    Blake3 = 4,
+    XXH3_128 = 5,   // Non-cryptographic, for integrity checks only
+    CRC32C = 6      // Checksum, detects accidental corruption only
+};
+
+// Numbers in signature files are little endian regardless of the platform
+inline void WriteLE32(unsigned char* out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+inline void WriteLE64(unsigned char* out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i) out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+inline uint32_t ReadLE32(const unsigned char* in)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    return value;
+}
+
+inline uint64_t ReadLE64(const unsigned char* in)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return value;
+}
+
+// Signature starts with a versioned header, which describes how it was generated, so it
+// can be read without knowing the settings. The header takes the first page of the file,
+// so the records start at a page boundary and can be indexed in a mapped file directly.
+//   magic           4 bytes "SIGN"
+//   version         1 byte
+//   algorithm       1 byte, HashAlgorithm value
+//   hash size       1 byte, size of every hash record
+//   flags           1 byte
+//   records offset  8 bytes, offset of the first record, a multiple of the page size
+//   block size      8 bytes
+//   input size      8 bytes, the last block is complemented with zeroes to the block size
+//   records         8 bytes, number of blocks or chunks
+// Header of version 1 has only the first 8 bytes, and the records follow it and the data
+// after it at once. It is written in raw mode for other algorithms than SHA-256, while
+// raw SHA-256 signatures are plain hash records, as they were before other algorithms.
+// With FLAG_MERKLE_TREE the 32-byte root of the tree follows the header fields, and the
+// levels of the tree above the block hashes follow the block hashes from the bottom up.
+// With FLAG_CHUNKS the input file is cut to chunks at content-defined boundaries.
+// The minimum, average and maximum chunk sizes follow the header fields as 4-byte numbers,
+// and every record is the 8-byte offset and the 4-byte length of a chunk followed
+// by its hash. With FLAG_WEAK_CHECKSUM every hash record ends with the 4-byte rolling
+// checksum of the block (see WeakChecksum), which is counted in the hash size.
+// Numbers are little endian.
+struct SignatureHeader
+{
+    static const size_t SIZE = 40;          // Size of the header fields of the current version
+    static const size_t SIZE_V1 = 8;        // Size of the header fields of version 1
+    static const uint8_t VERSION = 2;
+    static const uint8_t VERSION_1 = 1;
+    static const uint64_t RECORDS_ALIGNMENT = 4096;   // Records start at a page boundary
+    static const uint8_t FLAG_MERKLE_TREE = 1;
+    static const uint8_t FLAG_CHUNKS = 2;
+    static const uint8_t FLAG_WEAK_CHECKSUM = 4;
+    static const size_t MERKLE_ROOT_SIZE = 32;
+    static const size_t CHUNK_PARAMETERS_SIZE = 12;
+    static const size_t CHUNK_RECORD_PREFIX = 12;   // Size of the offset and the length preceding the hash of a chunk
+
+    HashAlgorithm algorithm;
+    uint8_t hashSize;
+    uint8_t flags;
+    uint8_t version = VERSION;
+    uint64_t recordsOffset = RECORDS_ALIGNMENT;
+    uint64_t blockSize = 0;
+    uint64_t inputSize = 0;
+    uint64_t records = 0;
+
+    static bool IsTagged(HashAlgorithm algorithm) {
+        return algorithm != HashAlgorithm::Sha256;
+    }
+
+    // Size of the header fields, the Merkle root or the chunk sizes follow them
+    size_t FieldsSize() const {
+        return (version == VERSION_1) ? SIZE_V1 : SIZE;
+    }
+
+    // Offset of the first record, which follows the data after the fields in version 1
+    uint64_t RecordsOffset() const {
+        if (version != VERSION_1) return recordsOffset;
+        if (flags & FLAG_CHUNKS) return SIZE_V1 + CHUNK_PARAMETERS_SIZE;
+        return SIZE_V1 + ((flags & FLAG_MERKLE_TREE) ? MERKLE_ROOT_SIZE : 0);
+    }
+
+    // Writes the fields of the header version
+    void Serialize(unsigned char out[SIZE]) const {
+        out[0] = 'S';
+        out[1] = 'I';
+        out[2] = 'G';
+        out[3] = 'N';
+        out[4] = version;
+        out[5] = static_cast<uint8_t>(algorithm);
+        out[6] = hashSize;
+        out[7] = flags;
+        if (version == VERSION_1) return;
+        WriteLE64(out + 8, recordsOffset);
+        WriteLE64(out + 16, blockSize);
+        WriteLE64(out + 24, inputSize);
+        WriteLE64(out + 32, records);
+    }
+
+    // Returns false if the data does not start with a header of a known version
+    bool Deserialize(const unsigned char* in, size_t len) {
+        if (len < SIZE_V1 || in[0] != 'S' || in[1] != 'I' || in[2] != 'G' || in[3] != 'N' ||
+            (in[4] != VERSION && in[4] != VERSION_1)) {
+            return false;
+        }
+        version = in[4];
+        algorithm = static_cast<HashAlgorithm>(in[5]);
+        hashSize = in[6];
+        flags = in[7];
+        if (version == VERSION_1) return true;
+
+        if (len < SIZE) return false;
+        recordsOffset = ReadLE64(in + 8);
+        blockSize = ReadLE64(in + 16);
+        inputSize = ReadLE64(in + 24);
+        records = ReadLE64(in + 32);
+        return recordsOffset >= SIZE;
+    }
+};
+
+// Checkpoint of a signature being generated is kept next to the signature, so an
+// interrupted generation can be resumed after the last block hashes that reached the disk.
+//   magic       4 bytes "SCKP"
+//   version     1 byte
+//   algorithm   1 byte, HashAlgorithm value
+//   hash size   1 byte
+//   flags       1 byte, flags of the signature header
+//   block size  8 bytes
+//   input size  8 bytes
+//   input time  8 bytes, last write time of the input file
+//   blocks      8 bytes, number of block hashes flushed to the disk
+//   checksum    4 bytes, CRC-32C of the preceding fields
+// Numbers are little endian.
+struct SignatureCheckpoint
+{
+    static const size_t SIZE = 44;
+    static const uint8_t VERSION = 1;
+
+    HashAlgorithm algorithm;
+    uint8_t hashSize;
+    uint8_t flags;
+    uint64_t blockSize;
+    uint64_t inputSize;
+    int64_t inputTime;
+    uint64_t blocks;
+
+    void Serialize(unsigned char out[SIZE]) const {
+        out[0] = 'S';
+        out[1] = 'C';
+        out[2] = 'K';
+        out[3] = 'P';
+        out[4] = VERSION;
+        out[5] = static_cast<uint8_t>(algorithm);
+        out[6] = hashSize;
+        out[7] = flags;
+        WriteLE64(out + 8, blockSize);
+        WriteLE64(out + 16, inputSize);
+        WriteLE64(out + 24, static_cast<uint64_t>(inputTime));
+        WriteLE64(out + 32, blocks);
+        WriteLE32(out + 40, CRC32C(out, SIZE - 4));
+    }
+
+    // Returns false if the data is not a complete checkpoint of a known version
+    bool Deserialize(const unsigned char* in, size_t len) {
+        if (len < SIZE || in[0] != 'S' || in[1] != 'C' || in[2] != 'K' || in[3] != 'P' || in[4] != VERSION) {
+            return false;
+        }
+        if (ReadLE32(in + 40) != CRC32C(in, SIZE - 4)) return false;
+
+        algorithm = static_cast<HashAlgorithm>(in[5]);
+        hashSize = in[6];
+        flags = in[7];
+        blockSize = ReadLE64(in + 8);
+        inputSize = ReadLE64(in + 16);
+        inputTime = static_cast<int64_t>(ReadLE64(in + 24));
+        blocks = ReadLE64(in + 32);
+        return true;
+    }
+};
+
+// Index of a signature maps every distinct hash of its records to the numbers of the
+// records that have it, so it can be mapped to memory and queried in place.
+//   magic      4 bytes "SIDX"
+//   version    1 byte
+//   algorithm  1 byte, HashAlgorithm value of the signature
+//   key size   1 byte, size of the hashes without weak checksums
+//   slot bits  1 byte, base 2 logarithm of the number of slots
+//   records    8 bytes, number of records of the signature
+//   distinct   8 bytes, number of distinct hashes
+// Slots of an open addressing table follow the header. Every slot is the 8-byte number
+// of records with its hash, which is zero in an empty slot, the 8-byte position of their
+// numbers in the list and the hash itself. Hash belongs to the slot given by its leading
+// bits or to the first free slot after it. The list of 8-byte record numbers follows the
+// table, numbers of a hash are adjacent and ascending. Numbers are little endian.
+struct SignatureIndexHeader
+{
+    static const size_t SIZE = 24;
+    static const uint8_t VERSION = 1;
+    static const size_t SLOT_PREFIX = 16;   // Size of the count and the position preceding the hash of a slot
+
+    HashAlgorithm algorithm;
+    uint8_t keySize;
+    uint8_t slotBits;
+    uint64_t records;
+    uint64_t distinct;
+
+    void Serialize(unsigned char out[SIZE]) const {
+        out[0] = 'S';
+        out[1] = 'I';
+        out[2] = 'D';
+        out[3] = 'X';
+        out[4] = VERSION;
+        out[5] = static_cast<uint8_t>(algorithm);
+        out[6] = keySize;
+        out[7] = slotBits;
+        WriteLE64(out + 8, records);
+        WriteLE64(out + 16, distinct);
+    }
+
+    // Returns false if the data does not start with a header of a known version
+    bool Deserialize(const unsigned char* in, size_t len) {
+        if (len < SIZE || in[0] != 'S' || in[1] != 'I' || in[2] != 'D' || in[3] != 'X' || in[4] != VERSION) {
+            return false;
+        }
+        algorithm = static_cast<HashAlgorithm>(in[5]);
+        keySize = in[6];
+        slotBits = in[7];
+        records = ReadLE64(in + 8);
+        distinct = ReadLE64(in + 16);
+        return true;
+    }
+};
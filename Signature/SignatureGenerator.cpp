@@ -1,114 +1,1239 @@
 #include "Windows.h"
 #include "SignatureGenerator.h"
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <chrono>
 
-SignatureGenerator::SignatureGenerator(const std::string inputFilePath, const std::string outputFilePath, const uint64_t blockSize) :
-    blockSize(blockSize)
+// Checks that the kernel forced by the user made it into the detected implementation.
+// A single allowed kernel is forced, a combination of them means automatic selection.
+// Kernels are matched with their lanes, so the 4-way SSE4.1 D64 kernel does not pass
+// for the 1-way SSE4 transform, which is built only with the assembly (USE_ASM).
+static bool IsImplementationSelected(sha256_implementation::UseImplementation requested, const std::string& selected)
 {
-    inputFile.open(inputFilePath, std::ios::in | std::ios::binary);
-    if (!inputFile) throw SignatureGeneratorException("Cannot open input file", ERROR_FILE_NOT_FOUND);
-    outputFile.open(outputFilePath, std::ios::out | std::ios::trunc | std::ios::binary);
-    if (!outputFile) throw SignatureGeneratorException("Cannot create output file. Does path exist?", ERROR_PATH_NOT_FOUND);
+    switch (requested) {
+    case sha256_implementation::USE_SSE4:
+        return selected.find("sse4(1way)") != std::string::npos;
+    case sha256_implementation::USE_SSE4_AND_AVX2:
+        return selected.find("avx2(") != std::string::npos;
+    case sha256_implementation::USE_SSE4_AND_AVX512:
+        return selected.find("avx512(") != std::string::npos;
+    case sha256_implementation::USE_SHANI:
+        return selected.find("shani(") != std::string::npos;
+    default:
+        return true;
+    }
+}
+
+SignatureGenerator::SignatureGenerator(const std::string inputFilePath, const std::string outputFilePath, const uint64_t givenBlockSize,
+    const ReaderSettings& reader, const HashSettings& hashSettings, const OutputSettings& output, const VerifySettings& verify,
+    const UpdateSettings& update, const ChunkingSettings& chunking, const SearchSettings& search) :
+    blockSize(givenBlockSize), reader(reader), hashing(hashSettings), output(output), verify(verify), update(update), chunking(chunking), search(search)
+{
+    if (reader.directIo && reader.mode != ReadMode::Positional && reader.mode != ReadMode::Async) {
+        throw SignatureGeneratorException("Direct reading is supported only in pread and async modes", ERROR_INVALID_DATA);
+    }
+    if (reader.mode == ReadMode::Stream) {
+        inputFile.open(inputFilePath, std::ios::in | std::ios::binary);
+        if (!inputFile) throw SignatureGeneratorException("Cannot open input file", ERROR_FILE_NOT_FOUND);
+    }
+
+    // Signature is read first, because its header gives the block size when it is not given
+    if (verify.enabled || update.enabled || search.enabled) {
+        OpenSignature(outputFilePath);
+    }
+
+    const DWORD directFlag = reader.directIo ? FILE_FLAG_NO_BUFFERING : 0;
+    if (reader.mode == ReadMode::Positional) {
+        inputHandle = CreateFileA(inputFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | directFlag, NULL);
+        if (inputHandle == INVALID_HANDLE_VALUE) throw SignatureGeneratorException("Cannot open input file", ERROR_FILE_NOT_FOUND);
+    }
+    else if (reader.mode == ReadMode::Async) {
+        if (reader.queueDepth == 0) throw SignatureGeneratorException("Queue depth must be greater than zero", ERROR_INVALID_DATA);
+        inputHandle = CreateFileA(inputFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | directFlag, NULL);
+        if (inputHandle == INVALID_HANDLE_VALUE) throw SignatureGeneratorException("Cannot open input file", ERROR_FILE_NOT_FOUND);
+        completionPort = CreateIoCompletionPort(inputHandle, NULL, 0, 1);
+        if (completionPort == NULL) throw SignatureGeneratorException("Cannot create completion port for asynchronous reading", ERROR_INVALID_FUNCTION);
+    }
+
+    if (reader.directIo) {
+        // Offsets, sizes and buffers of uncached reads must be aligned to the sector size
+        FILE_STORAGE_INFO storageInfo = { 0 };
+        if (!GetFileInformationByHandleEx(inputHandle, FileStorageInfo, &storageInfo, sizeof(storageInfo)) || storageInfo.LogicalBytesPerSector == 0) {
+            throw SignatureGeneratorException("Cannot get sector size of the input file device", ERROR_INVALID_FUNCTION);
+        }
+        bufferAlignment = (std::max)(static_cast<size_t>(storageInfo.LogicalBytesPerSector), DEFAULT_ALIGNMENT);
+        if (blockSize % storageInfo.LogicalBytesPerSector != 0) {
+            throw SignatureGeneratorException("Block size must be a multiple of the device sector size for direct reading", ERROR_INVALID_DATA);
+        }
+
+        // The last partial block ends at unaligned offset, so it is read with caching
+        tailHandle = CreateFileA(inputFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (tailHandle == INVALID_HANDLE_VALUE) throw SignatureGeneratorException("Cannot open input file", ERROR_FILE_NOT_FOUND);
+    }
+
+    if (update.enabled) {
+        outputFile.open(outputFilePath, std::ios::in | std::ios::out | std::ios::binary);
+        if (!outputFile) throw SignatureGeneratorException("Cannot open signature file", ERROR_FILE_NOT_FOUND);
+    }
+    else if (output.resume) {
+        // Resumed signature is continued in place
+        outputFile.open(outputFilePath, std::ios::in | std::ios::out | std::ios::binary);
+        if (!outputFile) throw SignatureGeneratorException("Cannot open output file to resume", ERROR_FILE_NOT_FOUND);
+    }
+    else if (search.enabled) {
+        if (!search.matchesPath.empty()) {
+            outputFile.open(search.matchesPath, std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!outputFile) throw SignatureGeneratorException("Cannot create matches file. Does path exist?", ERROR_PATH_NOT_FOUND);
+        }
+    }
+    else if (!verify.enabled) {
+        outputFile.open(outputFilePath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!outputFile) throw SignatureGeneratorException("Cannot create output file. Does path exist?", ERROR_PATH_NOT_FOUND);
+    }
     if (blockSize == 0) throw SignatureGeneratorException("Block size must be greater than zero", ERROR_INVALID_DATA);
 
     inputFileSize = boost::filesystem::file_size(inputFilePath);
     if (inputFileSize == 0) throw SignatureGeneratorException("Input file is empty", ERROR_INVALID_DATA);
     blocksCount = static_cast<uint64_t>(ceil((double)inputFileSize / (double)blockSize));
+    endBlock = blocksCount;
+    if (verify.enabled) {
+        // Only the requested range of blocks is read, hashed and compared
+        if (verify.firstBlock > verify.lastBlock || verify.firstBlock >= blocksCount) {
+            throw SignatureGeneratorException("Block range is out of the input file", ERROR_INVALID_DATA);
+        }
+        firstBlock = verify.firstBlock;
+        endBlock = (std::min)(verify.lastBlock, blocksCount - 1) + 1;
+        nextBlock = firstBlock;
+    }
+    else if (search.enabled) {
+        // Windows of the block size are checked at every offset of the mapped input file
+        if (reader.mode != ReadMode::Mapped) {
+            throw SignatureGeneratorException("Search is supported only in mmap reading mode", ERROR_INVALID_DATA);
+        }
+        if (!hashing.weakChecksum) {
+            throw SignatureGeneratorException("Signature has no weak checksums to search by", ERROR_NOT_SUPPORTED);
+        }
+    }
+    if (chunking.enabled) {
+        // Chunking threads cut segments of the mapped input file, the chunks may cross segment ends
+        if (reader.mode != ReadMode::Mapped) {
+            throw SignatureGeneratorException("Content-defined chunking is supported only in mmap reading mode", ERROR_INVALID_DATA);
+        }
+        if (output.merkleTree || output.resume || hashing.weakChecksum || verify.enabled || update.enabled || search.enabled) {
+            throw SignatureGeneratorException("Content-defined chunking does not support Merkle trees, resuming, weak checksums, verify, update and search modes", ERROR_NOT_SUPPORTED);
+        }
+        if (!(chunking.minSize > 0 && chunking.minSize < chunking.avgSize && chunking.avgSize < chunking.maxSize) ||
+            (chunking.avgSize & (chunking.avgSize - 1)) != 0) {
+            throw SignatureGeneratorException("Chunk sizes must grow from the minimum to the maximum, and the average one must be a power of two", ERROR_INVALID_DATA);
+        }
+        if (blockSize < 2ULL * chunking.maxSize) {
+            throw SignatureGeneratorException("Block size must be at least twice the maximum chunk size", ERROR_INVALID_DATA);
+        }
+        chunker = std::make_unique<GearChunker>(chunking.minSize, chunking.avgSize, chunking.maxSize);
+    }
+
     const unsigned int cores = std::thread::hardware_concurrency();
     numOfCores = (cores == 0) ? DEFAULT_NUM_OF_CORES : cores;
 
-    const uint64_t outputFileSize = blocksCount * HASH_SIZE;
-    const auto free = boost::filesystem::space(outputFilePath).free;
-    if (free < outputFileSize) {
-        throw SignatureGeneratorException("Not enough disk space for creating output signature file", ERROR_OUTOFMEMORY);
+    // Positional hashing and chunking threads read the file themselves, so only the writer core is reserved
+    const uint32_t reservedCores = (reader.mode == ReadMode::Positional || chunker) ? 1 : 2;
+    hashCores = (numOfCores > reservedCores) ? numOfCores - reservedCores : 1;
+    blockThreads = (blocksCount < hashCores) ? static_cast<unsigned>(hashCores / blocksCount) : 1;
+
+    // Dispatch the hash algorithm to the best kernel supported by the CPU once, before any hashing thread is started
+    if (hashing.algorithm == HashAlgorithm::Sha256) {
+        hashImplementation = SHA256AutoDetect(hashing.implementation);
+        if (!IsImplementationSelected(hashing.implementation, hashImplementation)) {
+            throw SignatureGeneratorException("Requested SHA-256 implementation is not supported by this CPU or build", ERROR_NOT_SUPPORTED);
+        }
+        std::cout << "SHA-256 implementation: " << hashImplementation << std::endl;
+    }
+    else if (hashing.algorithm == HashAlgorithm::Sha512 || hashing.algorithm == HashAlgorithm::Sha512_256) {
+        // SHA-512 has only the AVX2 kernel besides the standard one, other forced kernels would fall back silently
+        if (hashing.implementation != sha256_implementation::USE_ALL && hashing.implementation != sha256_implementation::STANDARD &&
+            hashing.implementation != sha256_implementation::USE_SSE4_AND_AVX2) {
+            throw SignatureGeneratorException("SHA-512 supports only auto, standard and avx2 implementations", ERROR_NOT_SUPPORTED);
+        }
+        hashImplementation = SHA512AutoDetect(hashing.implementation);
+        if (!IsImplementationSelected(hashing.implementation, hashImplementation)) {
+            throw SignatureGeneratorException("Requested SHA-512 implementation is not supported by this CPU or build", ERROR_NOT_SUPPORTED);
+        }
+        std::cout << "SHA-512 implementation: " << hashImplementation << std::endl;
+    }
+    else if (hashing.algorithm == HashAlgorithm::Blake3) {
+        hashImplementation = BLAKE3AutoDetect();
+        std::cout << "BLAKE3 implementation: " << hashImplementation << std::endl;
+    }
+    else if (hashing.algorithm == HashAlgorithm::CRC32C) {
+        hashImplementation = CRC32CAutoDetect();
+        std::cout << "CRC-32C implementation: " << hashImplementation << std::endl;
+    }
+
+    // Hashing pipeline is specialized for the selected algorithm, which also defines the size of hash records
+    switch (hashing.algorithm) {
+    case HashAlgorithm::Sha256:
+        UseHasher<Sha256Hasher>();
+        break;
+    case HashAlgorithm::Sha512:
+        UseHasher<Sha512Hasher>();
+        break;
+    case HashAlgorithm::Sha512_256:
+        UseHasher<Sha512_256Hasher>();
+        break;
+    case HashAlgorithm::XXH64:
+        UseHasher<XXH64Hasher>();
+        break;
+    case HashAlgorithm::Blake3:
+        UseHasher<Blake3Hasher>();
+        break;
+    case HashAlgorithm::XXH3_128:
+        UseHasher<XXH3Hasher>();
+        break;
+    case HashAlgorithm::CRC32C:
+        UseHasher<Crc32cHasher>();
+        break;
+    default:
+        throw SignatureGeneratorException("Unknown hash algorithm", ERROR_INVALID_DATA);
+    }
+
+    // Holes of a sparse input file are not read at all
+    QueryAllocatedRanges(inputFilePath);
+    if (sparseInput) {
+        std::cout << "Sparse input file, allocated ranges: " << allocatedRanges.size() << std::endl;
+    }
+
+    if (verify.enabled) {
+        // Signature must have a hash record for every block of the input file
+        const uint64_t hashesSize = signatureTree ? MerkleTree(blocksCount, nullptr).Size() : blocksCount * hashSize;
+        if (signatureSize != headerSize + hashesSize) {
+            throw SignatureGeneratorException("Signature does not correspond to the input file size and block size", ERROR_INVALID_DATA);
+        }
+    }
+    else if (update.enabled) {
+        PlanUpdate(inputFilePath, outputFilePath);
+    }
+    else if (search.enabled) {
+        CountSignatureBlocks();
+    }
+    else if (output.merkleTree) {
+        if (hashing.weakChecksum) {
+            throw SignatureGeneratorException("Merkle tree does not support weak checksums", ERROR_NOT_SUPPORTED);
+        }
+        if (hashSize != MerkleTree::NODE_SIZE) {
+            throw SignatureGeneratorException("Merkle tree requires a hash algorithm with 32-byte hashes", ERROR_INVALID_DATA);
+        }
+        // Interior nodes are hashed with SHA256D64, which is dispatched together with SHA-256
+        if (hashing.algorithm != HashAlgorithm::Sha256) SHA256AutoDetect(hashing.implementation);
+        tree = std::make_unique<MerkleTree>(blocksCount, [this](size_t level, uint64_t index, const unsigned char* nodes, size_t count) {
+            WriteTreeNodes(level, index, nodes, count);
+        });
+    }
+
+    if (!verify.enabled && !update.enabled && !search.enabled) {
+        if (!output.raw) {
+            // Header page keeps the Merkle root or the chunk sizes after the header fields
+            headerSize = SignatureHeader::RECORDS_ALIGNMENT;
+        }
+        else if (SignatureHeader::IsTagged(hashing.algorithm) || tree || chunker || hashing.weakChecksum) {
+            headerVersion = SignatureHeader::VERSION_1;
+            headerSize = SignatureHeader::SIZE_V1 + (tree ? MerkleTree::NODE_SIZE : 0) + (chunker ? SignatureHeader::CHUNK_PARAMETERS_SIZE : 0);
+        }
+        uint64_t outputFileSize = headerSize + (tree ? tree->Size() : blocksCount * hashSize);
+        if (chunker) {
+            // Number of chunks is known only after cutting, it is estimated by the average size
+            outputFileSize = headerSize + (inputFileSize / chunking.avgSize + 1) * (SignatureHeader::CHUNK_RECORD_PREFIX + hashSize);
+        }
+        const uint64_t existingSize = output.resume ? boost::filesystem::file_size(outputFilePath) : 0;
+        const auto free = boost::filesystem::space(outputFilePath).free;
+        if (outputFileSize > existingSize && free < outputFileSize - existingSize) {
+            throw SignatureGeneratorException("Not enough disk space for creating output signature file", ERROR_OUTOFMEMORY);
+        }
+
+        checkpointPath = outputFilePath + ".checkpoint";
+        inputTime = static_cast<int64_t>(boost::filesystem::last_write_time(inputFilePath));
+        if (output.resume) {
+            OpenCheckpoint(outputFilePath);
+        }
+        else {
+            // Checkpoint of a previous generation does not refer to the new signature
+            DeleteFileA(checkpointPath.c_str());
+        }
+        if (output.checkpointInterval > 0 && !chunker) {
+            outputHandle = CreateFileA(outputFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (outputHandle == INVALID_HANDLE_VALUE) throw SignatureGeneratorException("Cannot open output file for checkpoints", ERROR_PATH_NOT_FOUND);
+        }
+    }
+
+    // Mapped blocks are descriptors of the mapped region, so only the bounce buffer
+    // for the last partial block is allocated. Positional reading does not use the pool,
+    // but every hashing thread owns a buffer of the same size.
+    size_t poolBlockSize = static_cast<size_t>(blockSize);
+    if (reader.mode == ReadMode::Mapped) {
+        try {
+            inputMapping = boost::interprocess::file_mapping(inputFilePath.c_str(), boost::interprocess::read_only);
+            inputRegion = boost::interprocess::mapped_region(inputMapping, boost::interprocess::read_only);
+        }
+        catch (boost::interprocess::interprocess_exception&) {
+            throw SignatureGeneratorException("Cannot map input file to memory", ERROR_NOT_ENOUGH_MEMORY);
+        }
+        inputRegion.advise(boost::interprocess::mapped_region::advice_sequential);
+        if (inputFileSize % blockSize != 0) tailBlock.resize(static_cast<size_t>(blockSize), 0);
+        poolBlockSize = 0;
+    }
+
+    // Asynchronous reader needs a block for every read in flight besides the blocks being hashed
+    uint32_t poolSize = numOfCores * Q_RESERVATION_MULT;
+    if (reader.mode == ReadMode::Async) {
+        poolSize = (std::max)(poolSize, reader.queueDepth + numOfCores);
     }
 
     // Assuming Blocks Pool can consume no more than 1.5 GB of process memory
-    if (static_cast<uint64_t>(numOfCores) * static_cast<uint64_t>(Q_RESERVATION_MULT) * blockSize > BLOCKS_POOL_MEM_LIMIT) {
+    if (static_cast<uint64_t>(poolSize) * poolBlockSize > BLOCKS_POOL_MEM_LIMIT) {
         throw SignatureGeneratorException("Please, reduce the block size", ERROR_INVALID_DATA);
     }
 
-    blocksPool.Init("SignGen_semaphore", numOfCores * Q_RESERVATION_MULT);
+    // Hashing threads take as many blocks as the hasher hashes in parallel.
+    // Positional hashing threads own a buffer per block of the batch, so they are limited by the memory.
+    if (reader.mode == ReadMode::Positional) {
+        const uint64_t maxBatch = BLOCKS_POOL_MEM_LIMIT / (static_cast<uint64_t>(numOfCores) * blockSize);
+        batchSize = static_cast<size_t>((std::max)(static_cast<uint64_t>(1), (std::min)(static_cast<uint64_t>(batchSize), maxBatch)));
+    }
 
-    for (uint32_t i = 0; i < blocksPool.GetMaxItems(); ++i) {
-        auto block = std::make_shared<Block>(i, static_cast<size_t>(blockSize));
-        blocksPool.Release(block); // Add block to the pool
+    if (reader.mode == ReadMode::Async && reader.registeredBuffers) {
+        // Working set must be large enough to keep all the locked buffers
+        SIZE_T minWorkingSet = 0, maxWorkingSet = 0;
+        const SIZE_T poolMemory = static_cast<SIZE_T>(poolSize * poolBlockSize);
+        if (!GetProcessWorkingSetSize(GetCurrentProcess(), &minWorkingSet, &maxWorkingSet) ||
+            !SetProcessWorkingSetSize(GetCurrentProcess(), minWorkingSet + poolMemory, maxWorkingSet + poolMemory)) {
+            throw SignatureGeneratorException("Cannot extend working set for registered buffers", ERROR_NOT_ENOUGH_MEMORY);
+        }
+    }
+
+    if (reader.mode != ReadMode::Positional) {
+        blocksPool.Init(poolSize);
+        blockQ.Init(poolSize);
+
+        for (uint32_t i = 0; i < blocksPool.GetMaxItems(); ++i) {
+            auto block = std::make_shared<Block>(i, poolBlockSize, bufferAlignment);
+            if (reader.mode == ReadMode::Async && reader.registeredBuffers) {
+                if (!VirtualLock(block->block.data(), block->block.size())) {
+                    throw SignatureGeneratorException("Cannot lock registered buffers in memory", ERROR_NOT_ENOUGH_MEMORY);
+                }
+            }
+            blocksPool.Release(block); // Add block to the pool
+        }
     }
 
-    hashes.resize(static_cast<size_t>(blocksCount));
+    // Hashing can run ahead of writing by no more than the window size
+    hashes.Init(static_cast<size_t>(poolSize) * WINDOW_MULT, firstBlock);
+    if (chunker) segmentChunks.Init(static_cast<size_t>(numOfCores) * WINDOW_MULT);
 }
 
 SignatureGenerator::~SignatureGenerator()
 {
     outputFile.close();
+    signatureFile.close();
     inputFile.close();
+    if (completionPort != NULL) CloseHandle(completionPort);
+    if (tailHandle != INVALID_HANDLE_VALUE) CloseHandle(tailHandle);
+    if (outputHandle != INVALID_HANDLE_VALUE) CloseHandle(outputHandle);
+    if (inputHandle != INVALID_HANDLE_VALUE) CloseHandle(inputHandle);
 }
 
 void SignatureGenerator::ReadFileThread()
 {
-    for (int i = 0; i < blocksCount; ++i) {
+    // Stream is at the end of the previous range when several ranges are read
+    inputFile.clear();
+    inputFile.seekg(static_cast<std::streamoff>(firstBlock * blockSize));
+
+    for (uint64_t i = firstBlock; i < endBlock && !stopped; ++i) {
         auto block = blocksPool.Allocate();
 
         block->number = i;
+        block->hole = IsHole(i);
+        if (block->hole) {
+            if (i + 1 < blocksCount) inputFile.seekg(static_cast<std::streamoff>((i + 1) * blockSize));
+            blockQ.Push(block);
+            continue;
+        }
+
         auto bytesLeft = inputFileSize - inputFile.tellg();
         if (bytesLeft < blockSize) {
             memset(block->block.data(), 0, block->block.size());
         }
         inputFile.read(reinterpret_cast<char*>(block->block.data()), blockSize);
-        std::lock_guard<std::mutex> lock(blockQSync);
-        blockQ.push(block);
+        if (inputFile.gcount() != static_cast<std::streamsize>((std::min)(inputFileSize - i * blockSize, blockSize))) {
+            // Block that was not read is not hashed, the writer is released by closing the window
+            readFailed = true;
+            Stop();
+            blocksPool.Release(block);
+            break;
+        }
+        blockQ.Push(block);
     }
+    blockQ.Close();
 }
 
-void SignatureGenerator::WriteFileThread()
+void SignatureGenerator::MapFileThread()
 {
-    for (int i = 0; i < blocksCount; ++i) {
-        boost::unique_lock<boost::mutex> lk(hashes[i].mx);
-        while (!hashes[i].ready) {
-            hashes[i].cv.wait(lk);
+    const auto mapped = static_cast<const unsigned char*>(inputRegion.get_address());
+
+    for (uint64_t i = firstBlock; i < endBlock && !stopped; ++i) {
+        auto block = blocksPool.Allocate();
+
+        block->number = i;
+        block->hole = IsHole(i);
+        const uint64_t offset = i * blockSize;
+        const uint64_t bytesLeft = inputFileSize - offset;
+        if (block->hole) {
+            // Pages of holes are not touched
+            block->data = nullptr;
         }
+        else if (bytesLeft < blockSize) {
+            // Only the last block needs a copy to be complemented with zeroes
+            memcpy(tailBlock.data(), mapped + offset, static_cast<size_t>(bytesLeft));
+            block->data = tailBlock.data();
+        }
+        else {
+            block->data = mapped + offset;
+        }
+        blockQ.Push(block);
+    }
+    blockQ.Close();
+}
+
+void SignatureGenerator::AsyncReadFileThread()
+{
+    // OVERLAPPED goes first, so a completed read can be found by its OVERLAPPED pointer
+    struct AsyncRead
+    {
+        OVERLAPPED ov;
+        std::shared_ptr<Block> block;
+        DWORD length;
+    };
+
+    std::vector<AsyncRead> reads(reader.queueDepth);
+    std::vector<AsyncRead*> freeReads;
+    for (auto& read : reads) freeReads.push_back(&read);
+
+    uint64_t next = firstBlock;
+    uint32_t inFlight = 0;
+
+    while (next < endBlock || inFlight > 0) {
+        // Reads in flight own the pool blocks, so they are completed even after the stop
+        if (stopped) next = endBlock;
+
+        // Keep the queue full while there are blocks to read. Reader must not wait
+        // for a window slot while reads are in flight, because completed blocks
+        // are needed to move the window forward.
+        if (inFlight == 0 && next < endBlock) hashes.WaitSlot(next);
+        while (next < endBlock && !stopped && !freeReads.empty() && hashes.IsSlotFree(next)) {
+            if (IsHole(next)) {
+                // Holes do not need a read, so they are handed over at once
+                auto block = blocksPool.Allocate();
+                block->number = next;
+                block->hole = true;
+                blockQ.Push(block);
+                ++next;
+                continue;
+            }
+
+            auto read = freeReads.back();
+            freeReads.pop_back();
+
+            const uint64_t offset = next * blockSize;
+            read->block = blocksPool.Allocate();
+            read->block->number = next;
+            read->block->hole = false;
+
+            if (reader.directIo && inputFileSize - offset < blockSize) {
+                // Unaligned tail can not be read without caching
+                if (ReadBlock(read->block->block.data(), next)) {
+                    blockQ.Push(read->block);
+                }
+                else {
+                    readFailed = true;
+                    Stop();
+                    blocksPool.Release(read->block);
+                }
+                read->block.reset();
+                freeReads.push_back(read);
+                ++next;
+                continue;
+            }
+
+            read->length = static_cast<DWORD>((std::min)(inputFileSize - offset, blockSize));
+            if (read->length < blockSize) {
+                memset(read->block->block.data(), 0, read->block->block.size());
+            }
+
+            memset(&read->ov, 0, sizeof(read->ov));
+            read->ov.Offset = static_cast<DWORD>(offset);
+            read->ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            if (!ReadFile(inputHandle, read->block->block.data(), read->length, NULL, &read->ov) && GetLastError() != ERROR_IO_PENDING) {
+                // Read could not be started, the block is not hashed and the writer is released by closing the window
+                readFailed = true;
+                Stop();
+                blocksPool.Release(read->block);
+                read->block.reset();
+                freeReads.push_back(read);
+            }
+            else {
+                ++inFlight;
+            }
+            ++next;
+        }
+
+        if (inFlight == 0) continue;
+
+        DWORD bytesRead = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED ov = NULL;
+        if (!GetQueuedCompletionStatus(completionPort, &bytesRead, &key, &ov, INFINITE) && ov == NULL) {
+            // Port delivers no more completions, but the kernel writes to the OVERLAPPEDs and the blocks
+            // of the reads in flight until they complete, so they are cancelled and awaited before leaving
+            readFailed = true;
+            Stop();
+            CancelIoEx(inputHandle, NULL);
+            for (auto& read : reads) {
+                if (!read.block) continue;
+                while (!HasOverlappedIoCompleted(&read.ov)) Sleep(1);
+                blocksPool.Release(read.block);
+                read.block.reset();
+            }
+            break;
+        }
+
+        auto read = reinterpret_cast<AsyncRead*>(ov);
+        --inFlight;
+        if (bytesRead != read->length) {
+            readFailed = true;
+            Stop();
+        }
+
+        // Blocks completed after the stop are not hashed
+        if (stopped) blocksPool.Release(read->block);
+        else blockQ.Push(read->block);
+        read->block.reset();
+        freeReads.push_back(read);
+    }
+    blockQ.Close();
+}
 
-        outputFile.write((char*)hashes[i].hash.data(), HASH_SIZE);
+void SignatureGenerator::WriteFileThread()
+{
+    if (firstBlock > 0) {
+        // Resumed signature keeps the header and the hashes before the checkpoint
+        outputFile.seekp(static_cast<std::streamoff>(headerSize + firstBlock * hashSize));
+    }
+    else if (headerSize > 0) {
+        // Root is known only after the last block, so its place is reserved among the zeroes after the header fields
+        WriteHeader(HeaderFlags(), blocksCount);
+        const std::vector<char> padding(static_cast<size_t>(headerSize - MakeHeader(HeaderFlags(), blocksCount).FieldsSize()), 0);
+        outputFile.write(padding.data(), padding.size());
+    }
+
+    auto checkpointTime = std::chrono::steady_clock::now();
+    for (uint64_t i = firstBlock; i < endBlock; ++i) {
+        const Hash hash = hashes.Take(i);
+        if (stopped) return;
+
+        outputFile.write((char*)hash.data(), hashSize);
+        if (tree) tree->Add(hash.data());
         ShowProgress(static_cast<float>(i) / (static_cast<float>(blocksCount) - 1));
+
+        // Hashes written after a failed read may be wrong, so no checkpoint covers them
+        if (outputHandle != INVALID_HANDLE_VALUE && i + 1 < endBlock && !readFailed) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now - checkpointTime >= std::chrono::seconds(output.checkpointInterval)) {
+                WriteCheckpoint(i + 1);
+                checkpointTime = now;
+            }
+        }
+    }
+
+    if (tree) FinishTree();
+}
+
+void SignatureGenerator::WriteCheckpoint(uint64_t blocks)
+{
+    // Hashes reach the disk before the checkpoint that refers to them. Checkpoints are
+    // best effort, a failed one leaves the previous one in place.
+    outputFile.flush();
+    if (!FlushFileBuffers(outputHandle)) return;
+
+    SignatureCheckpoint checkpoint = { hashing.algorithm, static_cast<uint8_t>(hashSize), HeaderFlags(), blockSize, inputFileSize, inputTime, blocks };
+    unsigned char serialized[SignatureCheckpoint::SIZE];
+    checkpoint.Serialize(serialized);
+
+    // New checkpoint replaces the previous one only after it is written completely
+    const std::string temporaryPath = checkpointPath + ".tmp";
+    HANDLE handle = CreateFileA(temporaryPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return;
+    DWORD written = 0;
+    const bool done = WriteFile(handle, serialized, sizeof(serialized), &written, NULL) && written == sizeof(serialized) && FlushFileBuffers(handle);
+    CloseHandle(handle);
+    if (done) MoveFileExA(temporaryPath.c_str(), checkpointPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+void SignatureGenerator::OpenCheckpoint(const std::string& outputFilePath)
+{
+    std::ifstream checkpointFile(checkpointPath, std::ios::in | std::ios::binary);
+    unsigned char serialized[SignatureCheckpoint::SIZE] = { 0 };
+    checkpointFile.read((char*)serialized, sizeof(serialized));
+    SignatureCheckpoint checkpoint;
+    if (!checkpoint.Deserialize(serialized, static_cast<size_t>(checkpointFile.gcount()))) {
+        throw SignatureGeneratorException("Output file has no valid checkpoint to resume from", ERROR_FILE_NOT_FOUND);
+    }
+
+    const uint8_t flags = HeaderFlags();
+    if (checkpoint.algorithm != hashing.algorithm || checkpoint.hashSize != hashSize || checkpoint.flags != flags ||
+        checkpoint.blockSize != blockSize || checkpoint.inputSize != inputFileSize || checkpoint.inputTime != inputTime ||
+        checkpoint.blocks > blocksCount) {
+        throw SignatureGeneratorException("Checkpoint was made for another input file or settings", ERROR_INVALID_DATA);
+    }
+
+    // Signature must keep the header and the hashes it had at the checkpoint
+    if (boost::filesystem::file_size(outputFilePath) < headerSize + checkpoint.blocks * hashSize) {
+        throw SignatureGeneratorException("Output file is shorter than its checkpoint", ERROR_INVALID_DATA);
+    }
+    signatureFile.open(outputFilePath, std::ios::in | std::ios::binary);
+    if (!signatureFile) throw SignatureGeneratorException("Cannot open output file to resume", ERROR_FILE_NOT_FOUND);
+    if (headerSize > 0) {
+        const SignatureHeader header = MakeHeader(flags, blocksCount);
+        unsigned char expected[SignatureHeader::SIZE], stored[SignatureHeader::SIZE] = { 0 };
+        header.Serialize(expected);
+        signatureFile.read((char*)stored, header.FieldsSize());
+        if (memcmp(expected, stored, header.FieldsSize()) != 0) {
+            throw SignatureGeneratorException("Output file header does not match its checkpoint", ERROR_INVALID_DATA);
+        }
+    }
+    resumeBlock = checkpoint.blocks;
+}
+
+void SignatureGenerator::FinishTree()
+{
+    unsigned char root[MerkleTree::NODE_SIZE];
+    tree->Finish(root);
+    outputFile.seekp(MakeHeader(HeaderFlags(), blocksCount).FieldsSize());
+    outputFile.write((char*)root, sizeof(root));
+
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (unsigned char c : root) ss << std::setw(2) << static_cast<int>(c);
+    std::cout << std::endl << "Merkle root: " << ss.str() << std::endl;
+}
+
+void SignatureGenerator::WriteTreeNodes(size_t level, uint64_t index, const unsigned char* nodes, size_t count)
+{
+    // Levels of the tree have fixed offsets after the block hashes, so the writer
+    // puts completed nodes in place and returns to the end of the block hashes
+    const auto position = outputFile.tellp();
+    outputFile.seekp(static_cast<std::streamoff>(headerSize + tree->LevelOffset(level) + index * MerkleTree::NODE_SIZE));
+    outputFile.write((const char*)nodes, count * MerkleTree::NODE_SIZE);
+    outputFile.seekp(position);
+}
+
+void SignatureGenerator::UpdateFileThread()
+{
+    // Hashes of the range replace the previous ones, hashes of the appended blocks extend the signature
+    outputFile.seekp(static_cast<std::streamoff>(headerSize + firstBlock * hashSize));
+
+    for (uint64_t i = firstBlock; i < endBlock; ++i) {
+        const Hash hash = hashes.Take(i);
+
+        // Records are replaced in place, so nothing is written after a failed read
+        if (readFailed || stopped) {
+            Stop();
+            return;
+        }
+        outputFile.write((char*)hash.data(), hashSize);
+        ShowProgress(static_cast<float>(i - firstBlock) / (static_cast<float>(endBlock - firstBlock) - 1));
     }
-    writeCompleted = true;
 }
 
+void SignatureGenerator::RebuildTree()
+{
+    // Leaves are read back from the signature, and the levels above them are written after the leaves again
+    outputFile.flush();
+    tree = std::make_unique<MerkleTree>(blocksCount, [this](size_t level, uint64_t index, const unsigned char* nodes, size_t count) {
+        WriteTreeNodes(level, index, nodes, count);
+    });
+
+    AddStoredLeaves(blocksCount);
+    FinishTree();
+}
+
+void SignatureGenerator::AddStoredLeaves(uint64_t count)
+{
+    std::vector<unsigned char> leaves(SIGNATURE_CHUNK_RECORDS * MerkleTree::NODE_SIZE);
+    signatureFile.clear();
+    signatureFile.seekg(static_cast<std::streamoff>(headerSize));
+    for (uint64_t i = 0; i < count;) {
+        const size_t chunk = static_cast<size_t>((std::min)(static_cast<uint64_t>(SIGNATURE_CHUNK_RECORDS), count - i));
+        if (!signatureFile.read((char*)leaves.data(), chunk * MerkleTree::NODE_SIZE)) {
+            throw SignatureGeneratorException("Cannot read signature file", ERROR_READ_FAULT);
+        }
+        for (size_t j = 0; j < chunk; ++j) tree->Add(leaves.data() + j * MerkleTree::NODE_SIZE);
+        i += chunk;
+    }
+}
+
+void SignatureGenerator::VerifyFileThread()
+{
+    // Stored hashes are read by chunks, so memory does not depend on the size of the signature
+    std::vector<unsigned char> stored(SIGNATURE_CHUNK_RECORDS * hashSize);
+    signatureFile.seekg(static_cast<std::streamoff>(headerSize + firstBlock * hashSize));
+
+    uint64_t i = firstBlock;
+    while (i < endBlock) {
+        const size_t count = static_cast<size_t>((std::min)(static_cast<uint64_t>(SIGNATURE_CHUNK_RECORDS), endBlock - i));
+        if (!signatureFile.read((char*)stored.data(), count * hashSize)) {
+            signatureFailed = true;
+            Stop();
+            return;
+        }
+
+        for (size_t j = 0; j < count; ++j, ++i) {
+            const Hash hash = hashes.Take(i);
+            if (stopped) return;
+
+            if (memcmp(hash.data(), stored.data() + j * hashSize, hashSize) != 0) {
+                mismatches.push_back(i);
+                if (!verify.allMismatches) {
+                    Stop();
+                    return;
+                }
+            }
+            ShowProgress(static_cast<float>(i - firstBlock) / (static_cast<float>(endBlock - firstBlock) - 1));
+        }
+    }
+}
+
+void SignatureGenerator::Stop()
+{
+    // Reader and hashing threads check the flag, and the ones waiting for the window are released
+    stopped = true;
+    hashes.Close();
+}
+
+template<typename Hasher>
+void SignatureGenerator::UseHasher()
+{
+    static_assert(Hasher::OUTPUT_SIZE <= MAX_HASH_SIZE, "Hash record does not fit the reorder window slot");
+    hashSize = Hasher::OUTPUT_SIZE + (hashing.weakChecksum ? WeakChecksum::SIZE : 0);
+    batchSize = Hasher::Lanes();
+
+    // Hash of a zero block is computed once and used for all the blocks of zeroes
+    std::vector<unsigned char> zeroBlock(static_cast<size_t>(blockSize), 0);
+    const unsigned char* zeroData = zeroBlock.data();
+    unsigned char* zeroOutput = zeroHash.data();
+    Hasher::Hash(&zeroOutput, &zeroData, 1, zeroBlock.size(), blockThreads);
+    if (hashing.weakChecksum) WriteLE32(zeroOutput + Hasher::OUTPUT_SIZE, WeakChecksum::Compute(zeroData, zeroBlock.size()).Value());
+    hashingThread = (reader.mode == ReadMode::Positional) ? &SignatureGenerator::PositionalHashingThread<Hasher> : &SignatureGenerator::HashingThread<Hasher>;
+    if (chunker) {
+        hashingThread = &SignatureGenerator::ChunkingThread<Hasher>;
+        chunkWriterThread = &SignatureGenerator::WriteChunksThread<Hasher>;
+    }
+    blockSearch = &SignatureGenerator::SearchBlocks<Hasher>;
+}
+
+template<typename Hasher>
 void SignatureGenerator::HashingThread()
 {
+    std::vector<std::shared_ptr<Block>> batch;
+    std::vector<uint64_t> numbers;
+    std::vector<const unsigned char*> data;
     std::shared_ptr<Block> block;
 
-    while (!writeCompleted) {
+    // Waits for a block and adds the ones that are already available to the batch
+    while (blockQ.Pop(block)) {
+        batch.push_back(block);
+        while (batch.size() < batchSize && blockQ.TryPop(block)) {
+            batch.push_back(block);
+        }
+
+        for (auto& b : batch) {
+            numbers.push_back(b->number);
+            data.push_back(b->hole ? nullptr : b->data);
+        }
+        HashBlocks<Hasher>(numbers.data(), data.data(), batch.size());
+
+        for (auto& b : batch) blocksPool.Release(b);
+        batch.clear();
+        numbers.clear();
+        data.clear();
+    }
+    block.reset();
+}
+
+template<typename Hasher>
+void SignatureGenerator::PositionalHashingThread()
+{
+    std::vector<std::unique_ptr<AlignedBuffer>> buffers;
+    std::vector<uint64_t> numbers(batchSize);
+    std::vector<const unsigned char*> data(batchSize);
+    for (size_t j = 0; j < batchSize; ++j) {
+        buffers.push_back(std::make_unique<AlignedBuffer>(static_cast<size_t>(blockSize), bufferAlignment));
+    }
+
+    for (uint64_t first = nextBlock.fetch_add(batchSize); first < endBlock && !stopped; first = nextBlock.fetch_add(batchSize)) {
+        const size_t count = static_cast<size_t>((std::min)(static_cast<uint64_t>(batchSize), endBlock - first));
+        for (size_t j = 0; j < count; ++j) {
+            numbers[j] = first + j;
+            if (IsHole(numbers[j])) {
+                data[j] = nullptr;
+                continue;
+            }
+            data[j] = buffers[j]->data();
+            if (!ReadBlock(buffers[j]->data(), numbers[j])) {
+                // Blocks that were not read get no hash, the writer is released by closing the window
+                readFailed = true;
+                Stop();
+                return;
+            }
+        }
+        HashBlocks<Hasher>(numbers.data(), data.data(), count);
+    }
+}
+
+void SignatureGenerator::OpenSignature(const std::string& signatureFilePath)
+{
+    signatureFile.open(signatureFilePath, std::ios::in | std::ios::binary);
+    if (!signatureFile) throw SignatureGeneratorException("Cannot open signature file", ERROR_FILE_NOT_FOUND);
+    signatureSize = boost::filesystem::file_size(signatureFilePath);
+
+    // Signatures without a header are plain SHA-256 hash records. A header is recognized by
+    // its magic and version only, the size of a signature with a header may be a multiple
+    // of the SHA-256 record size as well.
+    unsigned char serialized[SignatureHeader::SIZE] = { 0 };
+    signatureFile.read((char*)serialized, sizeof(serialized));
+    SignatureHeader header;
+    if (header.Deserialize(serialized, static_cast<size_t>(signatureFile.gcount()))) {
+        if (header.flags & SignatureHeader::FLAG_CHUNKS) {
+            throw SignatureGeneratorException("Signature of content-defined chunks can not be used by blocks", ERROR_NOT_SUPPORTED);
+        }
+        if (header.version != SignatureHeader::VERSION_1) {
+            if (blockSize == 0) blockSize = header.blockSize;
+            if (header.blockSize != blockSize) {
+                throw SignatureGeneratorException("Signature was generated with another block size", ERROR_INVALID_DATA);
+            }
+        }
+        hashing.algorithm = header.algorithm;
+        hashing.weakChecksum = (header.flags & SignatureHeader::FLAG_WEAK_CHECKSUM) != 0;
+        signatureTree = (header.flags & SignatureHeader::FLAG_MERKLE_TREE) != 0;
+        headerVersion = header.version;
+        headerSize = header.RecordsOffset();
+
+        // Header of the current version counts the records, so the signature must have all of them
+        if (header.version != SignatureHeader::VERSION_1) {
+            const bool counted = header.records > 0 && header.hashSize > 0 && header.records <= signatureSize / header.hashSize;
+            const uint64_t hashesSize = !counted ? 0 :
+                signatureTree ? MerkleTree(header.records, nullptr).Size() : header.records * header.hashSize;
+            if (!counted || signatureSize != headerSize + hashesSize) {
+                throw SignatureGeneratorException("Signature file is damaged", ERROR_INVALID_DATA);
+            }
+        }
+    }
+    else {
+        hashing.algorithm = HashAlgorithm::Sha256;
+    }
+    // Older signatures do not store the block size, they are read with the default one
+    if (blockSize == 0) blockSize = DEFAULT_BLOCK_SIZE;
+    signatureFile.clear();
+}
+
+uint8_t SignatureGenerator::HeaderFlags() const
+{
+    return ((tree || signatureTree) ? SignatureHeader::FLAG_MERKLE_TREE : 0) | (hashing.weakChecksum ? SignatureHeader::FLAG_WEAK_CHECKSUM : 0);
+}
+
+SignatureHeader SignatureGenerator::MakeHeader(uint8_t flags, uint64_t records) const
+{
+    SignatureHeader header = { hashing.algorithm, static_cast<uint8_t>(hashSize), flags, headerVersion, headerSize, blockSize, inputFileSize, records };
+    return header;
+}
+
+void SignatureGenerator::WriteHeader(uint8_t flags, uint64_t records)
+{
+    // Only the header fields are written, the data after them is kept
+    const SignatureHeader header = MakeHeader(flags, records);
+    unsigned char serialized[SignatureHeader::SIZE];
+    header.Serialize(serialized);
+    outputFile.seekp(0);
+    outputFile.write((char*)serialized, header.FieldsSize());
+}
+
+void SignatureGenerator::CountSignatureBlocks()
+{
+    // Number of blocks of the signed file follows from the size of the signature
+    const uint64_t hashesSize = signatureSize - (std::min)(signatureSize, headerSize);
+    bool complete = false;
+    if (signatureTree) {
+        signatureBlocks = MerkleTree::LeavesOf(hashesSize);
+        complete = signatureBlocks > 0;
+    }
+    else {
+        signatureBlocks = hashesSize / hashSize;
+        complete = signatureBlocks > 0 && hashesSize % hashSize == 0;
+    }
+    if (!complete) throw SignatureGeneratorException("Signature file is damaged", ERROR_INVALID_DATA);
+}
+
+void SignatureGenerator::PlanUpdate(const std::string& inputFilePath, const std::string& signatureFilePath)
+{
+    // Signature was made for the previous version of the input file
+    CountSignatureBlocks();
+    if (blocksCount < signatureBlocks) {
+        throw SignatureGeneratorException("Input file is shorter than the signed one, signature must be generated again", ERROR_INVALID_DATA);
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    if (update.appendOnly || !update.dirtyRanges.empty()) {
+        for (const auto& range : update.dirtyRanges) {
+            if (range.second == 0 || range.first >= inputFileSize) continue;
+            const uint64_t end = (std::min)(range.first + range.second, inputFileSize);
+            ranges.emplace_back(range.first / blockSize, (end - 1) / blockSize + 1);
+        }
+        // The previous last block may be partial, so it is hashed again together with the appended ones
+        ranges.emplace_back(signatureBlocks - 1, blocksCount);
+    }
+    else if (blocksCount != signatureBlocks ||
+        boost::filesystem::last_write_time(inputFilePath) >= boost::filesystem::last_write_time(signatureFilePath)) {
+        // Changes are unknown, so the whole file is hashed unless the signature is newer
+        ranges.emplace_back(0, blocksCount);
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    for (const auto& range : ranges) {
+        if (!updateRanges.empty() && range.first <= updateRanges.back().second) {
+            updateRanges.back().second = (std::max)(updateRanges.back().second, range.second);
+        }
+        else {
+            updateRanges.push_back(range);
+        }
+    }
+
+    const uint64_t updatedSize = headerSize + (signatureTree ? MerkleTree(blocksCount, nullptr).Size() : blocksCount * hashSize);
+    if (updatedSize > signatureSize && boost::filesystem::space(signatureFilePath).free < updatedSize - signatureSize) {
+        throw SignatureGeneratorException("Not enough disk space for updating signature file", ERROR_OUTOFMEMORY);
+    }
 
-        {
-            std::lock_guard<std::mutex> lock(blockQSync);
-            if (!blockQ.empty()) {
-                block = blockQ.front();
-                blockQ.pop();
+    // Interior nodes are hashed with SHA256D64, which is dispatched together with SHA-256
+    if (signatureTree && hashing.algorithm != HashAlgorithm::Sha256) SHA256AutoDetect(hashing.implementation);
+}
+
+template<typename Hasher>
+void SignatureGenerator::ChunkingThread()
+{
+    const auto mapped = static_cast<const unsigned char*>(inputRegion.get_address());
+
+    // Every segment is cut from its start as if a chunk started there. The last chunk
+    // of a segment ends in the next one, where the writer joins the chunks of both.
+    for (uint64_t segment = nextBlock.fetch_add(1); segment < endBlock; segment = nextBlock.fetch_add(1)) {
+        auto chunks = std::make_shared<std::vector<ChunkRecord>>();
+        const uint64_t segmentEnd = (std::min)((segment + 1) * blockSize, inputFileSize);
+        for (uint64_t offset = segment * blockSize; offset < segmentEnd;) {
+            chunks->push_back(HashChunk<Hasher>(mapped, offset));
+            offset += chunks->back().length;
+        }
+        segmentChunks.Put(segment, chunks);
+    }
+}
+
+template<typename Hasher>
+void SignatureGenerator::WriteChunksThread()
+{
+    // Number of chunks is written to the header when all of them are written
+    WriteHeader(SignatureHeader::FLAG_CHUNKS, 0);
+    std::vector<unsigned char> parameters(static_cast<size_t>(headerSize - MakeHeader(SignatureHeader::FLAG_CHUNKS, 0).FieldsSize()), 0);
+    WriteLE32(parameters.data(), chunking.minSize);
+    WriteLE32(parameters.data() + 4, chunking.avgSize);
+    WriteLE32(parameters.data() + 8, chunking.maxSize);
+    outputFile.write((char*)parameters.data(), parameters.size());
+
+    // Boundaries found from the start of a segment meet the real ones within a few chunks,
+    // because they depend only on the content. Chunks of the segment are taken from the one
+    // that starts at the end of the written chunks, and the chunks before it are cut again.
+    const auto mapped = static_cast<const unsigned char*>(inputRegion.get_address());
+    uint64_t position = 0;
+    for (uint64_t segment = firstBlock; segment < endBlock; ++segment) {
+        const ChunkList chunks = segmentChunks.Take(segment);
+        const uint64_t segmentEnd = (std::min)((segment + 1) * blockSize, inputFileSize);
+
+        auto chunk = chunks->begin();
+        while (position < segmentEnd) {
+            while (chunk != chunks->end() && chunk->offset < position) ++chunk;
+            if (chunk != chunks->end() && chunk->offset == position) {
+                for (; chunk != chunks->end(); ++chunk) WriteChunk(*chunk);
+                position = chunks->back().offset + chunks->back().length;
             }
             else {
-                block.reset();
+                const ChunkRecord cut = HashChunk<Hasher>(mapped, position);
+                WriteChunk(cut);
+                position += cut.length;
+            }
+        }
+        ShowProgress(static_cast<float>(segment) / (static_cast<float>(blocksCount) - 1));
+    }
+    WriteHeader(SignatureHeader::FLAG_CHUNKS, chunksCount);
+    std::cout << std::endl << "Chunks: " << chunksCount << std::endl;
+}
+
+template<typename Hasher>
+SignatureGenerator::ChunkRecord SignatureGenerator::HashChunk(const unsigned char* data, uint64_t offset)
+{
+    ChunkRecord chunk;
+    chunk.offset = offset;
+    chunk.length = static_cast<uint32_t>(chunker->Cut(data, offset, inputFileSize) - offset);
+
+    const unsigned char* input = data + offset;
+    unsigned char* output = chunk.hash.data();
+    Hasher::Hash(&output, &input, 1, chunk.length, 1);
+    return chunk;
+}
+
+void SignatureGenerator::WriteChunk(const ChunkRecord& chunk)
+{
+    unsigned char prefix[SignatureHeader::CHUNK_RECORD_PREFIX];
+    WriteLE64(prefix, chunk.offset);
+    WriteLE32(prefix + 8, chunk.length);
+    outputFile.write((char*)prefix, sizeof(prefix));
+    outputFile.write((char*)chunk.hash.data(), hashSize);
+    ++chunksCount;
+}
+
+template<typename Hasher>
+uint64_t SignatureGenerator::SearchBlocks()
+{
+    // Strong hashes of the signature are kept in memory, and its weak checksums are sorted
+    // together with the numbers of their blocks, so the blocks of a checksum are adjacent
+    const size_t strongSize = Hasher::OUTPUT_SIZE;
+    std::vector<unsigned char> strong(static_cast<size_t>(signatureBlocks) * strongSize);
+    std::vector<std::pair<uint32_t, uint64_t>> weak(static_cast<size_t>(signatureBlocks));
+    std::vector<unsigned char> records(SIGNATURE_CHUNK_RECORDS * hashSize);
+    signatureFile.clear();
+    signatureFile.seekg(static_cast<std::streamoff>(headerSize));
+    for (uint64_t i = 0; i < signatureBlocks;) {
+        const size_t chunk = static_cast<size_t>((std::min)(static_cast<uint64_t>(SIGNATURE_CHUNK_RECORDS), signatureBlocks - i));
+        if (!signatureFile.read((char*)records.data(), chunk * hashSize)) {
+            throw SignatureGeneratorException("Cannot read signature file", ERROR_READ_FAULT);
+        }
+        for (size_t j = 0; j < chunk; ++j, ++i) {
+            const unsigned char* record = records.data() + j * hashSize;
+            memcpy(strong.data() + i * strongSize, record, strongSize);
+            weak[static_cast<size_t>(i)] = std::make_pair(ReadLE32(record + strongSize), i);
+        }
+    }
+    std::sort(weak.begin(), weak.end());
+
+    // Open addressing table maps a checksum to its first position in the sorted list. Most
+    // of the offsets match no block, so they are rejected by a bitmap with 32 bits per block,
+    // which is a few times smaller than the table and rarely lets them through.
+    static const uint64_t MIX = 0x9E3779B97F4A7C15ULL;
+    unsigned tableBits = 1, filterBits = 16;
+    while ((1ULL << tableBits) < 2 * weak.size()) ++tableBits;
+    while ((1ULL << filterBits) < 32 * weak.size()) ++filterBits;
+    const size_t tableMask = (static_cast<size_t>(1) << tableBits) - 1;
+    const size_t none = weak.size();
+    std::vector<size_t> table(tableMask + 1, none);
+    std::vector<uint64_t> filter((static_cast<size_t>(1) << filterBits) / 64, 0);
+    for (size_t k = 0; k < weak.size(); ++k) {
+        if (k > 0 && weak[k].first == weak[k - 1].first) continue;
+        const uint64_t mixed = weak[k].first * MIX;
+        const uint64_t bit = mixed >> (64 - filterBits);
+        filter[static_cast<size_t>(bit / 64)] |= 1ULL << (bit % 64);
+        size_t slot = static_cast<size_t>(mixed >> (64 - tableBits));
+        while (table[slot] != none) slot = (slot + 1) & tableMask;
+        table[slot] = k;
+    }
+    auto filtered = [&](uint32_t value) {
+        const uint64_t bit = (value * MIX) >> (64 - filterBits);
+        return ((filter[static_cast<size_t>(bit / 64)] >> (bit % 64)) & 1) != 0;
+    };
+    auto find = [&](uint32_t value) {
+        for (size_t slot = static_cast<size_t>((value * MIX) >> (64 - tableBits)); table[slot] != none; slot = (slot + 1) & tableMask) {
+            if (weak[table[slot]].first == value) return table[slot];
+        }
+        return none;
+    };
+
+    // Window of the block size slides over the input file byte by byte and jumps over
+    // every match, as rsync does. A tail shorter than a block is never matched.
+    const auto mapped = static_cast<const unsigned char*>(inputRegion.get_address());
+    const size_t window = static_cast<size_t>(blockSize);
+    uint64_t found = 0;
+    uint64_t expected = 0;  // Block following the previous match, which is preferred among equal blocks
+    uint64_t progress = 0;
+    WeakChecksum checksum;
+    bool started = false;
+    Hash candidate;
+    for (uint64_t offset = 0; offset + window <= inputFileSize;) {
+        if (!started) {
+            checksum = WeakChecksum::Compute(mapped + offset, window);
+            started = true;
+        }
+
+        // Offsets rejected by the filter are rolled over in a tight loop up to the next progress update
+        const uint64_t last = (std::min)(inputFileSize - window, progress);
+        while (offset < last && !filtered(checksum.Value())) {
+            checksum.Roll(mapped[offset], mapped[offset + window]);
+            ++offset;
+        }
+        if (offset >= progress) {
+            ShowProgress(static_cast<float>(offset) / static_cast<float>(inputFileSize));
+            progress = offset + SEARCH_PROGRESS_STEP;
+        }
+
+        const uint32_t value = checksum.Value();
+        uint64_t block = UINT64_MAX;
+        size_t k = filtered(value) ? find(value) : none;
+        if (k != none) {
+            const unsigned char* input = mapped + offset;
+            unsigned char* output = candidate.data();
+            Hasher::Hash(&output, &input, 1, window, 1);
+            for (; k < weak.size() && weak[k].first == value && block != expected; ++k) {
+                if (memcmp(candidate.data(), strong.data() + weak[k].second * strongSize, strongSize) == 0) {
+                    if (block == UINT64_MAX || weak[k].second == expected) block = weak[k].second;
+                }
             }
         }
 
-        if (block) {
-            auto num = block->number;
-            auto& hash = hashes[static_cast<const unsigned int>(num)];
+        if (block != UINT64_MAX) {
+            if (outputFile.is_open()) {
+                unsigned char match[16];
+                WriteLE64(match, offset);
+                WriteLE64(match + 8, block);
+                outputFile.write((char*)match, sizeof(match));
+            }
+            ++found;
+            expected = block + 1;
+            offset += window;
+            started = false;
+        }
+        else {
+            if (offset + window == inputFileSize) break;
+            checksum.Roll(mapped[offset], mapped[offset + window]);
+            ++offset;
+        }
+    }
+    ShowProgress(1.0f);
+    return found;
+}
 
-            Hasher hasher;
-            hasher.Reset();
-            hasher.Write(block->block.data(), static_cast<size_t>(blockSize));
-            hasher.Finalize(hash.hash.data());
+void SignatureGenerator::QueryAllocatedRanges(const std::string& inputFilePath)
+{
+    const DWORD attributes = GetFileAttributesA(inputFilePath.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_SPARSE_FILE)) return;
 
-            blocksPool.Release(block);
+    HANDLE handle = CreateFileA(inputFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return;
+
+    // Ranges are returned in ascending order, the query is continued after the last one while there are more
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    query.FileOffset.QuadPart = 0;
+    query.Length.QuadPart = static_cast<LONGLONG>(inputFileSize);
+    FILE_ALLOCATED_RANGE_BUFFER ranges[64];
+    for (;;) {
+        DWORD bytesReturned = 0;
+        const BOOL done = DeviceIoControl(handle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), ranges, sizeof(ranges), &bytesReturned, NULL);
+        if (!done && GetLastError() != ERROR_MORE_DATA) {
+            // Holes are an optimization only, the whole file is read if they are unknown
+            allocatedRanges.clear();
+            CloseHandle(handle);
+            return;
+        }
+
+        const DWORD count = bytesReturned / sizeof(ranges[0]);
+        for (DWORD i = 0; i < count; ++i) {
+            allocatedRanges.emplace_back(ranges[i].FileOffset.QuadPart, ranges[i].Length.QuadPart);
+        }
+        if (done || count == 0) break;
+
+        const uint64_t end = ranges[count - 1].FileOffset.QuadPart + ranges[count - 1].Length.QuadPart;
+        query.FileOffset.QuadPart = static_cast<LONGLONG>(end);
+        query.Length.QuadPart = static_cast<LONGLONG>(inputFileSize - end);
+    }
+    CloseHandle(handle);
+    sparseInput = true;
+}
+
+bool SignatureGenerator::IsHole(uint64_t number) const
+{
+    if (!sparseInput) return false;
+
+    // Block is a hole if the first allocated range that ends after its start begins after its end
+    const uint64_t begin = number * blockSize;
+    const uint64_t end = (std::min)(begin + blockSize, inputFileSize);
+    auto range = std::partition_point(allocatedRanges.begin(), allocatedRanges.end(),
+        [begin](const std::pair<uint64_t, uint64_t>& r) { return r.first + r.second <= begin; });
+    return range == allocatedRanges.end() || range->first >= end;
+}
+
+bool SignatureGenerator::ReadAt(HANDLE handle, unsigned char* buffer, DWORD length, uint64_t offset)
+{
+    DWORD done = 0;
+    while (done < length) {
+        OVERLAPPED ov = { 0 };
+        ov.Offset = static_cast<DWORD>(offset + done);
+        ov.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD bytesRead = 0;
+        if (!ReadFile(handle, buffer + done, length - done, &bytesRead, &ov) || bytesRead == 0) {
+            return false;
+        }
+        done += bytesRead;
+    }
+    return true;
+}
+
+bool SignatureGenerator::ReadBlock(unsigned char* buffer, uint64_t number)
+{
+    const uint64_t offset = number * blockSize;
+    const uint64_t bytesLeft = inputFileSize - offset;
+    if (bytesLeft < blockSize) {
+        memset(buffer, 0, static_cast<size_t>(blockSize));
+        HANDLE handle = (tailHandle != INVALID_HANDLE_VALUE) ? tailHandle : inputHandle;
+        return ReadAt(handle, buffer, static_cast<DWORD>(bytesLeft), offset);
+    }
+    return ReadAt(inputHandle, buffer, static_cast<DWORD>(blockSize), offset);
+}
 
-            {
-                boost::lock_guard<boost::mutex> lk(hash.mx);
-                hash.ready = true;
-                hash.cv.notify_all();
+template<typename Hasher>
+void SignatureGenerator::HashBlocks(const uint64_t numbers[], const unsigned char* const data[], size_t count)
+{
+    std::vector<Hash> batchHashes(count);
+    std::vector<unsigned char*> outputs;
+    std::vector<const unsigned char*> inputs;
+
+    // Blocks of zeroes and holes, which have no data, get the precomputed hash.
+    // The rest of the blocks are hashed together.
+    for (size_t i = 0; i < count; ++i) {
+        if (!data[i] || IsZero(data[i], static_cast<size_t>(blockSize))) {
+            batchHashes[i] = zeroHash;
+        }
+        else {
+            // Weak checksum is computed in a pass of its own before the strong hashes of the batch.
+            // Single-lane hashers get batches of one block, so they read it right after the checksum,
+            // from the cache if it fits there. Multi-lane hashers read all the blocks of a batch together
+            // and can not be fed a block in parts, so large blocks are read from memory twice.
+            if (hashing.weakChecksum) {
+                WriteLE32(batchHashes[i].data() + Hasher::OUTPUT_SIZE, WeakChecksum::Compute(data[i], static_cast<size_t>(blockSize)).Value());
             }
+            outputs.push_back(batchHashes[i].data());
+            inputs.push_back(data[i]);
         }
     }
+    if (!inputs.empty()) {
+        Hasher::Hash(outputs.data(), inputs.data(), inputs.size(), static_cast<size_t>(blockSize), blockThreads);
+    }
+
+    // Hashes are put in ascending order, so putting a hash that is ahead
+    // of the window never waits for a block of the same batch
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return numbers[a] < numbers[b]; });
+    for (size_t i : order) hashes.Put(numbers[i], batchHashes[i]);
 }
 
 void SignatureGenerator::ShowProgress(float progress)
@@ -129,18 +1254,114 @@ void SignatureGenerator::ShowProgress(float progress)
 
 void SignatureGenerator::Generate()
 {
-    std::thread fileReader(&SignatureGenerator::ReadFileThread, this);
-    std::thread fileWriter(&SignatureGenerator::WriteFileThread, this);
+    if (verify.enabled || update.enabled || search.enabled) throw SignatureGeneratorException("Signature generator is created for an existing signature", ERROR_INVALID_FUNCTION);
+
+    try {
+        if (resumeBlock > 0) {
+            // The last hashes before the checkpoint are checked against the input file,
+            // then the rest of the blocks are hashed and written after them
+            firstBlock = resumeBlock - (std::min)(RESUME_CHECK_BLOCKS, resumeBlock);
+            endBlock = resumeBlock;
+            nextBlock = firstBlock;
+            hashes.Reset(firstBlock);
+            Run(&SignatureGenerator::VerifyFileThread);
+            if (signatureFailed || !mismatches.empty()) {
+                throw SignatureGeneratorException("Output file does not match the input file before the checkpoint, signature must be generated again", ERROR_INVALID_DATA);
+            }
+            if (tree) AddStoredLeaves(resumeBlock);
+
+            if (reader.mode != ReadMode::Positional) blockQ.Reopen();
+            firstBlock = resumeBlock;
+            endBlock = blocksCount;
+            nextBlock = firstBlock;
+            hashes.Reset(firstBlock);
+            std::cout << std::endl << "Resuming after block " << resumeBlock - 1 << std::endl;
+        }
+        Run(chunker ? chunkWriterThread : &SignatureGenerator::WriteFileThread);
+    }
+    catch (SignatureGeneratorException&) {
+        // Resuming checks only the last hashes before the checkpoint, so the checkpoint
+        // of a failed run is removed rather than trusted with hashes that may be wrong
+        DeleteFileA(checkpointPath.c_str());
+        throw;
+    }
+
+    // Signature is complete, so its checkpoint is not needed anymore
+    outputFile.flush();
+    DeleteFileA(checkpointPath.c_str());
+}
+
+bool SignatureGenerator::Verify()
+{
+    if (!verify.enabled) throw SignatureGeneratorException("Signature generator is not created for verification", ERROR_INVALID_FUNCTION);
+    Run(&SignatureGenerator::VerifyFileThread);
+
+    if (signatureFailed) throw SignatureGeneratorException("Cannot read signature file", ERROR_READ_FAULT);
+    return mismatches.empty();
+}
+
+uint64_t SignatureGenerator::Update()
+{
+    if (!update.enabled) throw SignatureGeneratorException("Signature generator is not created for updating", ERROR_INVALID_FUNCTION);
+
+    // Pipeline is run for every range of changed blocks starting from its first block
+    uint64_t hashed = 0;
+    for (size_t i = 0; i < updateRanges.size(); ++i) {
+        if (i > 0 && reader.mode != ReadMode::Positional) blockQ.Reopen();
+        firstBlock = updateRanges[i].first;
+        endBlock = updateRanges[i].second;
+        nextBlock = firstBlock;
+        hashes.Reset(firstBlock);
+
+        Run(&SignatureGenerator::UpdateFileThread);
+        hashed += endBlock - firstBlock;
+    }
+
+    // Header of the current version describes the updated input file
+    if (headerSize > 0 && headerVersion != SignatureHeader::VERSION_1) WriteHeader(HeaderFlags(), blocksCount);
+
+    if (signatureTree && hashed > 0) RebuildTree();
+    outputFile.flush();
+    return hashed;
+}
+
+uint64_t SignatureGenerator::Search()
+{
+    if (!search.enabled) throw SignatureGeneratorException("Signature generator is not created for searching", ERROR_INVALID_FUNCTION);
+
+    const uint64_t found = (this->*blockSearch)();
+    outputFile.flush();
+    if (!search.matchesPath.empty() && !outputFile) {
+        throw SignatureGeneratorException("Cannot write matches file", ERROR_WRITE_FAULT);
+    }
+    return found;
+}
+
+void SignatureGenerator::Run(void (SignatureGenerator::*consumer)())
+{
+    // Positional hashing threads and chunking threads read the input file themselves
+    std::thread fileReader;
+    if (reader.mode == ReadMode::Stream) {
+        fileReader = std::thread(&SignatureGenerator::ReadFileThread, this);
+    }
+    else if (reader.mode == ReadMode::Mapped && !chunker) {
+        fileReader = std::thread(&SignatureGenerator::MapFileThread, this);
+    }
+    else if (reader.mode == ReadMode::Async) {
+        fileReader = std::thread(&SignatureGenerator::AsyncReadFileThread, this);
+    }
+    std::thread fileWriter(consumer, this);
 
     std::vector<std::thread> hashProcessors;
-    uint32_t hashCores = (numOfCores >= 3) ? numOfCores - 2 : 1;
-    for (uint32_t i = 0; i < hashCores; ++i) // Reserve 2 cores for reader and writer
+    for (uint32_t i = 0; i < hashCores; ++i) // Reserve cores for reader and writer
     {
-        hashProcessors.push_back(std::move(std::thread(&SignatureGenerator::HashingThread, this)));
+        hashProcessors.push_back(std::move(std::thread(hashingThread, this)));
     }
 
     for (auto& hp : hashProcessors) hp.join();
 
     fileWriter.join();
-    fileReader.join();
+    if (fileReader.joinable()) fileReader.join();
+
+    if (readFailed) throw SignatureGeneratorException("Cannot read input file", ERROR_READ_FAULT);
 }
@@ -1,39 +1,146 @@
 #pragma once
+#include "Windows.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <array>
 #include <queue>
-#include <sha256.h>
-#include <boost/thread.hpp>
+#include <sstream>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include "Pool.h"
+#include "ReorderWindow.h"
+#include "Hashers.h"
+#include "SignatureFormat.h"
+#include "ZeroScan.h"
+#include "MerkleTree.h"
+#include "GearChunker.h"
+#include "WeakChecksum.h"
 
 #define KB 1024ULL
 #define MB (KB * 1024ULL)
 #define GB (MB * 1024ULL)
 
-// Block structure allows tracking read block number
-struct Block
+// Defines the way input file is read
+enum class ReadMode
 {
-    uint64_t number;
-    std::vector<unsigned char> block;
+    Stream,     // Reader thread copies blocks from the file stream to the pool buffers
+    Mapped,     // Input file is mapped to memory and blocks are hashed in place
+    Positional, // Every hashing thread reads its own blocks at their offsets, no reader thread is used
+    Async       // Reader thread keeps several overlapped reads in flight and completes them out of order
+};
+
+// Settings of the input file reading
+struct ReaderSettings
+{
+    ReadMode mode = ReadMode::Stream;
+    uint32_t queueDepth = 32;           // Number of reads kept in flight in asynchronous mode
+    bool registeredBuffers = false;     // Lock block buffers in physical memory for asynchronous reads
+    bool directIo = false;              // Bypass the system file cache in positional and asynchronous modes
+};
+
+// Settings of the block hashing
+struct HashSettings
+{
+    HashAlgorithm algorithm = HashAlgorithm::Sha256;
+
+    // SHA-256 and SHA-512 kernels allowed to be selected at startup, the best supported one is used
+    sha256_implementation::UseImplementation implementation = sha256_implementation::USE_ALL;
+
+    bool weakChecksum = false;  // Append the rolling checksum of rsync to every hash record, so blocks can be found at any offset
+};
+
+// Settings of the signature file layout
+struct OutputSettings
+{
+    bool merkleTree = false;            // Append a Merkle tree over the block hashes and put its root to the header
+    uint32_t checkpointInterval = 30;   // Seconds between checkpoints of the signature being generated, 0 disables them
+    bool resume = false;                // Continue the generation interrupted after the last checkpoint
+    bool raw = false;                   // Write the layout of the first version: plain SHA-256 hash records or the 8-byte header
+};
 
-    Block(uint64_t num, size_t blockSize)
-        : number(num) {
-        block.resize(blockSize);
+// Settings of cutting the input file to chunks at content-defined boundaries instead of fixed blocks
+struct ChunkingSettings
+{
+    bool enabled = false;
+    uint32_t minSize = 2 * 1024;
+    uint32_t avgSize = 8 * 1024;    // Power of two
+    uint32_t maxSize = 64 * 1024;
+};
+
+// Settings of checking the input file against an existing signature
+struct VerifySettings
+{
+    bool enabled = false;               // Output file is the signature to check against, it is only read
+    bool allMismatches = false;         // Check all the blocks instead of stopping at the first mismatch
+    uint64_t firstBlock = 0;            // Range of blocks to check, the last block is included
+    uint64_t lastBlock = UINT64_MAX;
+};
+
+// Settings of updating the signature of a changed input file in place
+struct UpdateSettings
+{
+    bool enabled = false;       // Output file is the signature of the previous version of the input file
+    bool appendOnly = false;    // Data was only appended, so only the blocks after the previous end are hashed
+    std::vector<std::pair<uint64_t, uint64_t>> dirtyRanges; // Offsets and lengths of the changed data.
+                                                            // Unless given, all blocks are hashed if the input file is newer than the signature.
+};
+
+// Settings of searching the input file for the blocks of a signature with weak checksums.
+// Every match is written as the 8-byte offset in the input file followed by the 8-byte
+// number of the block of the signature, both little endian, in the order of offsets.
+struct SearchSettings
+{
+    bool enabled = false;       // Output file is the signature of the blocks to find, it is only read
+    std::string matchesPath;    // File the matches are written to, they are only counted if it is empty
+};
+
+// AlignedBuffer is a fixed size buffer which start address is aligned
+// to the given boundary. It is required for reading without file caching.
+class AlignedBuffer
+{
+private:
+    unsigned char* buffer = nullptr;
+    size_t length = 0;
+
+public:
+    AlignedBuffer(size_t size, size_t alignment) : length(size) {
+        if (size > 0) {
+            buffer = static_cast<unsigned char*>(_aligned_malloc(size, alignment));
+            if (!buffer) throw std::bad_alloc();
+        }
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    ~AlignedBuffer() {
+        if (buffer) _aligned_free(buffer);
+    }
+
+    unsigned char* data() {
+        return buffer;
+    }
+
+    size_t size() const {
+        return length;
     }
 };
 
-// Hash structure allows to track whether a specific hash has been calculated
-struct Hash
+// Block structure allows tracking read block number. Data points either
+// to the own buffer of the block or to the mapped region of the input file.
+// Mapped blocks do not own a buffer and serve as lightweight descriptors.
+struct Block
 {
-    boost::mutex mx;
-    boost::condition_variable cv;
-    bool ready = false;
-    std::array<unsigned char, CSHA256::OUTPUT_SIZE> hash;
+    uint64_t number;
+    const unsigned char* data;
+    AlignedBuffer block;
+    bool hole = false;  // Block lies in a hole of a sparse input file, so it is not read and hashed as zeroes
 
-    Hash() : hash{ 0 } {}
-    Hash(const Hash& item) : hash{ 0 } {}
+    Block(uint64_t num, size_t blockSize, size_t alignment)
+        : number(num), block(blockSize, alignment) {
+        data = block.data();
+    }
 };
 
 // This exception contains information that can be shown to the user
@@ -60,32 +167,157 @@ private:
     static const uint32_t DEFAULT_NUM_OF_CORES = 4UL;
     static const uint32_t Q_RESERVATION_MULT = 4UL;     // Multiplier for processing units reservation
     static const uint64_t BLOCKS_POOL_MEM_LIMIT = 1.5 * GB;
-    static const uint32_t HASH_SIZE = CSHA256::OUTPUT_SIZE;
-    typedef CSHA256 Hasher;
+    static const uint32_t MAX_HASH_SIZE = CSHA512::OUTPUT_SIZE;   // The largest hash of the supported algorithms
+    static const uint32_t MAX_RECORD_SIZE = MAX_HASH_SIZE + WeakChecksum::SIZE;  // The largest hash record with a weak checksum
+    static const uint32_t WINDOW_MULT = 2UL;            // Multiplier of the reorder window size relative to the pool
+    static const size_t DEFAULT_ALIGNMENT = 64;         // Cache line size
+    static const size_t SIGNATURE_CHUNK_RECORDS = 4096; // Number of hash records read from an existing signature at once
+    static const uint64_t RESUME_CHECK_BLOCKS = 16;     // Number of blocks before the checkpoint hashed again to check a resumed signature
+    static const uint64_t SEARCH_PROGRESS_STEP = 16 * MB;   // Number of bytes searched between updates of the progress bar
+    typedef std::array<unsigned char, MAX_RECORD_SIZE> Hash;
+
+    // Chunk of the input file cut at content-defined boundaries
+    struct ChunkRecord
+    {
+        uint64_t offset;
+        uint32_t length;
+        Hash hash;
+    };
+    typedef std::shared_ptr<std::vector<ChunkRecord>> ChunkList;
 
     std::ifstream inputFile;
-    std::ofstream outputFile;
-    const uint64_t blockSize;
+    std::fstream outputFile;
+    std::ifstream signatureFile;    // Signature the input file is checked against in verify mode or searched for in search mode
+    uint64_t blockSize;             // Taken from the existing signature when it is not given
+    const ReaderSettings reader;
+    HashSettings hashing;           // Algorithm and weak checksums are taken from the existing signature
+    const OutputSettings output;
+    const VerifySettings verify;
+    const UpdateSettings update;
+    const ChunkingSettings chunking;
+    const SearchSettings search;
+    std::string hashImplementation;     // Name of the implementation of the hash algorithm selected at startup
+
+    boost::interprocess::file_mapping inputMapping;
+    boost::interprocess::mapped_region inputRegion;
+    std::vector<unsigned char> tailBlock;       // Zero-padded copy of the last partial block for mapped reading
+    HANDLE inputHandle = INVALID_HANDLE_VALUE;  // Input file handle for positional and asynchronous reading
+    HANDLE completionPort = NULL;               // Completion port of asynchronous reads
+    HANDLE tailHandle = INVALID_HANDLE_VALUE;   // Cached input file handle for the unaligned tail in direct mode
+    size_t bufferAlignment = DEFAULT_ALIGNMENT; // Alignment of block buffers, equals to sector size in direct mode
+    HANDLE outputHandle = INVALID_HANDLE_VALUE; // Output file handle for flushing the signature to the disk at checkpoints
 
     uint64_t inputFileSize;
-    uint64_t blocksCount;   // Total number of blocks to be processed
+    uint64_t blocksCount;   // Total number of blocks of the input file
+    uint64_t firstBlock = 0;    // Range of blocks to be processed, the end is excluded
+    uint64_t endBlock = 0;
     uint32_t numOfCores;    // The number of cores in the system
+    uint32_t hashCores;     // The number of hashing threads
+    unsigned blockThreads;  // The number of threads hashing a single block when blocks are fewer than hashing threads
+    size_t batchSize;       // The number of blocks hashed at once by a hashing thread
+    size_t hashSize;        // Size of a hash record of the selected algorithm, including the weak checksum
+    Hash zeroHash;          // Hash of a block of zeroes, which is also the hash of a zero tail padded to the block size
+    std::vector<std::pair<uint64_t, uint64_t>> allocatedRanges; // Offsets and lengths of the data of a sparse input file
+    bool sparseInput = false;                                   // Allocated ranges are known, the rest of the file is holes
+    uint64_t headerSize = 0;            // Size of the signature header and the Merkle root which precede block hashes
+    uint8_t headerVersion = SignatureHeader::VERSION;   // Version of the header of the signature, if it has one
+    std::unique_ptr<MerkleTree> tree;   // Merkle tree over block hashes which is built by the writer
+    std::string checkpointPath;         // Checkpoint of the signature being generated, it is removed after the last block
+    int64_t inputTime = 0;              // Last write time of the input file, which is saved in checkpoints
+    uint64_t resumeBlock = 0;           // First block after the checkpoint of the resumed signature
+    std::unique_ptr<GearChunker> chunker;   // Finds chunk boundaries in chunking mode, blocks are segments cut to chunks in parallel
+    uint64_t chunksCount = 0;               // Number of chunks written to the signature
+    uint64_t signatureSize = 0;         // Size of the existing signature file in verify, update and search modes
+    bool signatureTree = false;         // Existing signature contains a Merkle tree
+    uint64_t signatureBlocks = 0;       // Number of blocks of the existing signature
+    std::vector<std::pair<uint64_t, uint64_t>> updateRanges;    // Ranges of blocks to be hashed again in update mode, the end is excluded
+    bool signatureFailed = false;       // Signals that the signature file could not be read
+    std::vector<uint64_t> mismatches;   // Numbers of blocks which hashes differ from the signature
 
     SyncPool<Block> blocksPool;                 // Pool of Blocks for better memory management
-    std::queue<std::shared_ptr<Block>> blockQ;  // Queue of Blocks for processing
-    std::vector<Hash> hashes;                   // Vector of Hashes that is not supposed to consume much memory
-    std::mutex blockQSync;
-    std::atomic<bool> writeCompleted = false;   // Signals that write to the output file is finished
+    SyncQueue<std::shared_ptr<Block>> blockQ;   // Queue of Blocks for processing
+    ReorderWindow<Hash> hashes;                 // Hashes of blocks in flight in the order of writing
+    ReorderWindow<ChunkList> segmentChunks;     // Chunks of segments in flight in the order of writing in chunking mode
+    std::atomic<uint64_t> nextBlock = 0;        // Next block to be claimed by positional hashing threads
+    std::atomic<bool> readFailed = false;       // Signals that the input file could not be read
+    std::atomic<bool> stopped = false;          // Signals readers and hashing threads to stop before the end of the range
 
     void ReadFileThread();
+    void MapFileThread();
+    void AsyncReadFileThread();
     void WriteFileThread();
-    void HashingThread();
+    void VerifyFileThread();
+    void UpdateFileThread();
+    void WriteTreeNodes(size_t level, uint64_t index, const unsigned char* nodes, size_t count);
+    template<typename Hasher> void HashingThread();
+    template<typename Hasher> void PositionalHashingThread();
+    void (SignatureGenerator::*hashingThread)() = nullptr;  // Hashing thread specialized for the selected algorithm
+    template<typename Hasher> void ChunkingThread();
+    template<typename Hasher> void WriteChunksThread();
+    void (SignatureGenerator::*chunkWriterThread)() = nullptr;  // Chunks writer specialized for the selected algorithm
+    template<typename Hasher> ChunkRecord HashChunk(const unsigned char* data, uint64_t offset);
+    void WriteChunk(const ChunkRecord& chunk);
+    template<typename Hasher> uint64_t SearchBlocks();
+    uint64_t (SignatureGenerator::*blockSearch)() = nullptr;   // Search specialized for the algorithm of the signature
+
+    template<typename Hasher> void UseHasher();
+    template<typename Hasher> void HashBlocks(const uint64_t numbers[], const unsigned char* const data[], size_t count);
+    void OpenSignature(const std::string& signatureFilePath);
+    void CountSignatureBlocks();
+    uint8_t HeaderFlags() const;
+    SignatureHeader MakeHeader(uint8_t flags, uint64_t records) const;
+    void WriteHeader(uint8_t flags, uint64_t records);
+    void PlanUpdate(const std::string& inputFilePath, const std::string& signatureFilePath);
+    void RebuildTree();
+    void AddStoredLeaves(uint64_t count);
+    void WriteCheckpoint(uint64_t blocks);
+    void OpenCheckpoint(const std::string& outputFilePath);
+    void FinishTree();
+    void Run(void (SignatureGenerator::*consumer)());
+    void Stop();
+    void QueryAllocatedRanges(const std::string& inputFilePath);
+    bool IsHole(uint64_t number) const;
+    bool ReadAt(HANDLE handle, unsigned char* buffer, DWORD length, uint64_t offset);
+    bool ReadBlock(unsigned char* buffer, uint64_t number);
 
     inline void ShowProgress(float progress);
 
 public:
-    SignatureGenerator(const std::string inputFilePath, const std::string outputFilePath, const uint64_t blockSize);
+    static const uint64_t DEFAULT_BLOCK_SIZE = 1 * MB;
+
+    // Block size 0 in verify, update and search modes takes the block size from the header
+    // of the signature, or the default one if the signature has no block size.
+    SignatureGenerator(const std::string inputFilePath, const std::string outputFilePath, const uint64_t blockSize,
+        const ReaderSettings& reader = ReaderSettings(), const HashSettings& hashing = HashSettings(),
+        const OutputSettings& output = OutputSettings(), const VerifySettings& verify = VerifySettings(),
+        const UpdateSettings& update = UpdateSettings(), const ChunkingSettings& chunking = ChunkingSettings(),
+        const SearchSettings& search = SearchSettings());
     ~SignatureGenerator();
     void Generate();
+
+    // Checks the input file against the signature given as the output file.
+    // Returns false if any block of the range does not match.
+    bool Verify();
+
+    // Hashes again the changed blocks of the input file and writes their hashes to the signature
+    // given as the output file. Returns the number of hashed blocks.
+    uint64_t Update();
+
+    // Finds the blocks of the signature given as the output file at any offset of the input file
+    // and writes the matches to the matches file. Returns the number of matches.
+    uint64_t Search();
+
+    // Numbers of the blocks that do not match the signature, only the first one unless all are requested
+    const std::vector<uint64_t>& GetMismatches() const {
+        return mismatches;
+    }
+
+    uint64_t GetBlockSize() const {
+        return blockSize;
+    }
+
+    const std::string& GetHashImplementation() const {
+        return hashImplementation;
+    }
 };
 
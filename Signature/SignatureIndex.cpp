@@ -0,0 +1,338 @@
+#include "Windows.h"
+#include "SignatureIndex.h"
+#include "SignatureGenerator.h"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <fstream>
+
+namespace {
+
+const unsigned DEFAULT_THREADS = 4;
+const unsigned PARTITIONS_PER_THREAD = 8;   // Partitions are smaller than the share of a thread, so threads finish together
+
+// Records of a signature file mapped to memory, whatever layout the signature has
+class MappedSignature
+{
+public:
+    HashAlgorithm algorithm = HashAlgorithm::Sha256;
+    size_t keySize = CSHA256::OUTPUT_SIZE;  // Size of the hash of a record without the weak checksum
+    uint64_t count = 0;
+
+    explicit MappedSignature(const std::string& path);
+
+    const unsigned char* Key(uint64_t record) const {
+        return keys + record * stride;
+    }
+
+private:
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    const unsigned char* keys = nullptr;    // Hash of the first record
+    size_t stride = CSHA256::OUTPUT_SIZE;   // Distance between hashes of adjacent records
+};
+
+MappedSignature::MappedSignature(const std::string& path)
+{
+    boost::system::error_code error;
+    const uint64_t size = boost::filesystem::file_size(path, error);
+    if (error) throw SignatureGeneratorException("Cannot open signature file", ERROR_FILE_NOT_FOUND);
+    if (size == 0) throw SignatureGeneratorException("Signature file is empty", ERROR_INVALID_DATA);
+    try {
+        mapping = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+        region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+    }
+    catch (boost::interprocess::interprocess_exception&) {
+        throw SignatureGeneratorException("Cannot map signature file to memory", ERROR_NOT_ENOUGH_MEMORY);
+    }
+    const auto data = static_cast<const unsigned char*>(region.get_address());
+
+    // Signatures without a header are plain SHA-256 hash records
+    SignatureHeader header;
+    uint64_t recordsOffset = 0;
+    size_t keyOffset = 0;
+    bool tree = false;
+    bool counted = false;
+    if (header.Deserialize(data, static_cast<size_t>(size))) {
+        const size_t weakSize = (header.flags & SignatureHeader::FLAG_WEAK_CHECKSUM) ? WeakChecksum::SIZE : 0;
+        if (header.hashSize <= weakSize) throw SignatureGeneratorException("Signature file is damaged", ERROR_INVALID_DATA);
+        algorithm = header.algorithm;
+        stride = header.hashSize;
+        keySize = header.hashSize - weakSize;
+        recordsOffset = header.RecordsOffset();
+        counted = header.version != SignatureHeader::VERSION_1;
+        if (header.flags & SignatureHeader::FLAG_CHUNKS) {
+            // Hash of a chunk follows its offset and length
+            keyOffset = SignatureHeader::CHUNK_RECORD_PREFIX;
+            stride += SignatureHeader::CHUNK_RECORD_PREFIX;
+        }
+        else if (header.flags & SignatureHeader::FLAG_MERKLE_TREE) {
+            // Leaves of the tree are the block hashes, the levels above them are not indexed
+            tree = true;
+        }
+    }
+
+    const uint64_t recordsSize = size - (std::min)(size, recordsOffset);
+    bool complete = false;
+    if (tree) {
+        count = MerkleTree::LeavesOf(recordsSize);
+        complete = count > 0;
+    }
+    else {
+        count = recordsSize / stride;
+        complete = count > 0 && recordsSize % stride == 0;
+    }
+    if (counted && header.records != count) complete = false;
+    if (!complete) throw SignatureGeneratorException("Signature file is damaged", ERROR_INVALID_DATA);
+    keys = data + recordsOffset + keyOffset;
+}
+
+// Leading bytes of a hash as a number, shorter hashes are complemented with zeroes
+uint64_t Prefix(const unsigned char* hash, size_t size)
+{
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i) prefix = (prefix << 8) | (i < size ? hash[i] : 0);
+    return prefix;
+}
+
+uint64_t HighBits(uint64_t value, unsigned bits)
+{
+    return bits == 0 ? 0 : value >> (64 - bits);
+}
+
+// Runs the function by the given number of threads and passes every thread its number
+template<typename Function>
+void RunThreads(unsigned threads, Function function)
+{
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) workers.emplace_back(function, t);
+    for (auto& worker : workers) worker.join();
+}
+
+unsigned ThreadsCount()
+{
+    const unsigned cores = std::thread::hardware_concurrency();
+    return (cores == 0) ? DEFAULT_THREADS : cores;
+}
+
+} // namespace
+
+uint64_t SignatureIndex::Build(const std::string& signaturePath, const std::string& indexPath)
+{
+    const MappedSignature signature(signaturePath);
+    const unsigned threads = ThreadsCount();
+    const size_t keySize = signature.keySize;
+    auto rangeBegin = [&](unsigned t) { return signature.count * t / threads; };
+
+    // Records are partitioned by the leading bits of their hashes. Every thread counts
+    // the records of its range in every partition, and then puts them after the records
+    // of the previous threads, so the partitions are filled without locks.
+    unsigned partitionBits = 0;
+    while ((1ULL << partitionBits) < static_cast<uint64_t>(threads) * PARTITIONS_PER_THREAD) ++partitionBits;
+    const size_t partitions = static_cast<size_t>(1) << partitionBits;
+
+    struct Entry
+    {
+        uint64_t prefix;
+        uint64_t record;
+    };
+    std::vector<Entry> entries(static_cast<size_t>(signature.count));
+    std::vector<std::vector<uint64_t>> positions(threads, std::vector<uint64_t>(partitions, 0));
+    RunThreads(threads, [&](unsigned t) {
+        for (uint64_t r = rangeBegin(t); r < rangeBegin(t + 1); ++r) {
+            ++positions[t][static_cast<size_t>(HighBits(Prefix(signature.Key(r), keySize), partitionBits))];
+        }
+    });
+    std::vector<uint64_t> partitionBegin(partitions + 1, 0);
+    uint64_t position = 0;
+    for (size_t p = 0; p < partitions; ++p) {
+        partitionBegin[p] = position;
+        for (unsigned t = 0; t < threads; ++t) {
+            const uint64_t count = positions[t][p];
+            positions[t][p] = position;
+            position += count;
+        }
+    }
+    partitionBegin[partitions] = position;
+    RunThreads(threads, [&](unsigned t) {
+        for (uint64_t r = rangeBegin(t); r < rangeBegin(t + 1); ++r) {
+            const uint64_t prefix = Prefix(signature.Key(r), keySize);
+            entries[static_cast<size_t>(positions[t][static_cast<size_t>(HighBits(prefix, partitionBits))]++)] = { prefix, r };
+        }
+    });
+
+    // Sorting by the hash makes the records of a hash adjacent and puts hashes in the order of their slots
+    auto same = [&](const Entry& a, const Entry& b) {
+        return a.prefix == b.prefix && memcmp(signature.Key(a.record), signature.Key(b.record), keySize) == 0;
+    };
+    std::vector<uint64_t> distinct(partitions, 0);
+    std::atomic<size_t> nextPartition = 0;
+    RunThreads(threads, [&](unsigned) {
+        for (size_t p = nextPartition++; p < partitions; p = nextPartition++) {
+            const auto first = entries.begin() + static_cast<ptrdiff_t>(partitionBegin[p]);
+            const auto last = entries.begin() + static_cast<ptrdiff_t>(partitionBegin[p + 1]);
+            std::sort(first, last, [&](const Entry& a, const Entry& b) {
+                if (a.prefix != b.prefix) return a.prefix < b.prefix;
+                const int order = memcmp(signature.Key(a.record), signature.Key(b.record), keySize);
+                return order != 0 ? order < 0 : a.record < b.record;
+            });
+            for (auto e = first; e != last; ++e) {
+                if (e == first || !same(*(e - 1), *e)) ++distinct[p];
+            }
+        }
+    });
+
+    // Table is at most two thirds full, so probing stops at an empty slot soon
+    SignatureIndexHeader header = { signature.algorithm, static_cast<uint8_t>(keySize), 0, signature.count, 0 };
+    for (uint64_t d : distinct) header.distinct += d;
+    unsigned slotBits = (std::max)(partitionBits, 1U);
+    while ((1ULL << slotBits) < header.distinct + header.distinct / 2) ++slotBits;
+    header.slotBits = static_cast<uint8_t>(slotBits);
+    const size_t slotSize = SignatureIndexHeader::SLOT_PREFIX + keySize;
+    const uint64_t slotMask = (1ULL << slotBits) - 1;
+    const uint64_t listOffset = SignatureIndexHeader::SIZE + (slotMask + 1) * slotSize;
+    const uint64_t indexSize = listOffset + signature.count * 8;
+
+    {
+        std::ofstream indexFile(indexPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!indexFile) throw SignatureGeneratorException("Cannot create index file. Does path exist?", ERROR_PATH_NOT_FOUND);
+    }
+    if (boost::filesystem::space(indexPath).free < indexSize) {
+        throw SignatureGeneratorException("Not enough disk space for creating index file", ERROR_OUTOFMEMORY);
+    }
+    boost::interprocess::file_mapping indexMapping;
+    boost::interprocess::mapped_region indexRegion;
+    try {
+        boost::filesystem::resize_file(indexPath, indexSize);
+        indexMapping = boost::interprocess::file_mapping(indexPath.c_str(), boost::interprocess::read_write);
+        indexRegion = boost::interprocess::mapped_region(indexMapping, boost::interprocess::read_write);
+    }
+    catch (std::exception&) {
+        throw SignatureGeneratorException("Cannot map index file to memory", ERROR_NOT_ENOUGH_MEMORY);
+    }
+    const auto index = static_cast<unsigned char*>(indexRegion.get_address());
+    unsigned char* const slots = index + SignatureIndexHeader::SIZE;
+    unsigned char* const list = index + listOffset;
+    auto putSlot = [&](uint64_t slot, uint64_t first, uint64_t count) {
+        unsigned char* entry = slots + slot * slotSize;
+        WriteLE64(entry, count);
+        WriteLE64(entry + 8, first);
+        memcpy(entry + SignatureIndexHeader::SLOT_PREFIX, signature.Key(entries[static_cast<size_t>(first)].record), keySize);
+    };
+
+    // Hashes of a partition have their slots in its own range of the table, so partitions
+    // are put in parallel. A hash takes its slot or the next free one in the order of slots.
+    // Hashes that do not fit the range take free slots after it when all partitions are put.
+    const unsigned rangeBits = slotBits - partitionBits;
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> spills(partitions);
+    nextPartition = 0;
+    RunThreads(threads, [&](unsigned) {
+        for (size_t p = nextPartition++; p < partitions; p = nextPartition++) {
+            const uint64_t rangeEnd = static_cast<uint64_t>(p + 1) << rangeBits;
+            uint64_t slot = static_cast<uint64_t>(p) << rangeBits;
+            for (uint64_t i = partitionBegin[p]; i < partitionBegin[p + 1];) {
+                uint64_t j = i;
+                for (; j < partitionBegin[p + 1] && same(entries[static_cast<size_t>(i)], entries[static_cast<size_t>(j)]); ++j) {
+                    WriteLE64(list + j * 8, entries[static_cast<size_t>(j)].record);
+                }
+                slot = (std::max)(slot, HighBits(entries[static_cast<size_t>(i)].prefix, slotBits));
+                if (slot < rangeEnd) putSlot(slot++, i, j - i);
+                else spills[p].emplace_back(i, j - i);
+                i = j;
+            }
+        }
+    });
+    for (const auto& spill : spills) {
+        for (const auto& hash : spill) {
+            uint64_t slot = HighBits(entries[static_cast<size_t>(hash.first)].prefix, slotBits);
+            while (ReadLE64(slots + slot * slotSize) != 0) slot = (slot + 1) & slotMask;
+            putSlot(slot, hash.first, hash.second);
+        }
+    }
+
+    header.Serialize(index);
+    if (!indexRegion.flush()) throw SignatureGeneratorException("Cannot write index file", ERROR_WRITE_FAULT);
+    return header.distinct;
+}
+
+SignatureIndex::SignatureIndex(const std::string& indexPath)
+{
+    try {
+        mapping = boost::interprocess::file_mapping(indexPath.c_str(), boost::interprocess::read_only);
+        region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+    }
+    catch (boost::interprocess::interprocess_exception&) {
+        throw SignatureGeneratorException("Cannot map index file to memory", ERROR_FILE_NOT_FOUND);
+    }
+    const auto data = static_cast<const unsigned char*>(region.get_address());
+    if (!header.Deserialize(data, region.get_size()) || header.keySize == 0 || header.slotBits == 0 || header.slotBits > 48) {
+        throw SignatureGeneratorException("File is not a signature index", ERROR_INVALID_DATA);
+    }
+
+    slotSize = SignatureIndexHeader::SLOT_PREFIX + header.keySize;
+    slotMask = (1ULL << header.slotBits) - 1;
+    const uint64_t listOffset = SignatureIndexHeader::SIZE + (slotMask + 1) * slotSize;
+    if (region.get_size() != listOffset + header.records * 8) {
+        throw SignatureGeneratorException("Index file is damaged", ERROR_INVALID_DATA);
+    }
+    slots = data + SignatureIndexHeader::SIZE;
+    list = data + listOffset;
+}
+
+SignatureIndex::Records SignatureIndex::Find(const unsigned char* hash) const
+{
+    Records records;
+    for (uint64_t slot = HighBits(Prefix(hash, header.keySize), header.slotBits);; slot = (slot + 1) & slotMask) {
+        const unsigned char* entry = slots + slot * slotSize;
+        const uint64_t count = ReadLE64(entry);
+        if (count == 0) break;
+        if (memcmp(entry + SignatureIndexHeader::SLOT_PREFIX, hash, header.keySize) == 0) {
+            records.list = list + ReadLE64(entry + 8) * 8;
+            records.count = count;
+            break;
+        }
+    }
+    return records;
+}
+
+uint64_t SignatureIndex::Join(const std::string& signaturePath, const std::string& outputPath) const
+{
+    const MappedSignature signature(signaturePath);
+    if (signature.algorithm != header.algorithm || signature.keySize != header.keySize) {
+        throw SignatureGeneratorException("Signature and index use different hash algorithms", ERROR_INVALID_DATA);
+    }
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!outputFile) throw SignatureGeneratorException("Cannot create output file. Does path exist?", ERROR_PATH_NOT_FOUND);
+    }
+
+    // Threads look up consecutive ranges of records, so their matches are written in the order of records
+    const unsigned threads = ThreadsCount();
+    std::vector<std::vector<unsigned char>> matches(threads);
+    std::vector<uint64_t> found(threads, 0);
+    RunThreads(threads, [&](unsigned t) {
+        const uint64_t end = signature.count * (t + 1) / threads;
+        for (uint64_t r = signature.count * t / threads; r < end; ++r) {
+            const Records records = Find(signature.Key(r));
+            if (records.count == 0) continue;
+            ++found[t];
+            if (outputFile.is_open()) {
+                unsigned char match[16];
+                WriteLE64(match, r);
+                WriteLE64(match + 8, records[0]);
+                matches[t].insert(matches[t].end(), match, match + sizeof(match));
+            }
+        }
+    });
+
+    uint64_t shared = 0;
+    for (unsigned t = 0; t < threads; ++t) {
+        if (outputFile.is_open()) outputFile.write((const char*)matches[t].data(), matches[t].size());
+        shared += found[t];
+    }
+    if (outputFile.is_open() && !outputFile.flush()) throw SignatureGeneratorException("Cannot write output file", ERROR_WRITE_FAULT);
+    return shared;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "SignatureFormat.h"
+
+// SignatureIndex answers which records of a signature have the given hash. The index
+// is an open addressing table stored in a file, which is mapped to memory and queried
+// in place, so a lookup touches a slot or a few adjacent ones. Hashes are uniformly
+// distributed, so their leading bits are the slot numbers without hashing them again.
+// Records are blocks or content-defined chunks in the order of the signature.
+class SignatureIndex
+{
+public:
+    // Numbers of the records with a hash, they point to the mapped index
+    struct Records
+    {
+        const unsigned char* list = nullptr;
+        uint64_t count = 0;
+
+        uint64_t operator[](uint64_t i) const {
+            return ReadLE64(list + i * 8);
+        }
+    };
+
+    // Builds the index of the signature by several threads and writes it to the index file.
+    // Returns the number of distinct hashes.
+    static uint64_t Build(const std::string& signaturePath, const std::string& indexPath);
+
+    explicit SignatureIndex(const std::string& indexPath);
+
+    // Returns the records with the hash of the key size, none if the hash is not in the index
+    Records Find(const unsigned char* hash) const;
+
+    // Finds the records of the other signature which hashes are in the index. Every such
+    // record is written to the output file, unless its path is empty, as its 8-byte number
+    // followed by the 8-byte number of the first record of the index with the same hash.
+    // Returns the number of such records.
+    uint64_t Join(const std::string& signaturePath, const std::string& outputPath) const;
+
+    const SignatureIndexHeader& Header() const {
+        return header;
+    }
+
+private:
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    SignatureIndexHeader header;
+    const unsigned char* slots = nullptr;
+    const unsigned char* list = nullptr;
+    size_t slotSize = 0;
+    uint64_t slotMask = 0;
+};
@@ -0,0 +1,49 @@
+#include "WeakChecksum.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define WEAK_CHECKSUM_SSE2
+#endif
+
+WeakChecksum WeakChecksum::Compute(const unsigned char* data, size_t len)
+{
+    // After every step of k bytes the weighted sum grows by k times the sum of the bytes
+    // before them and by the bytes of the step weighted from k down to 1
+    uint32_t a = 0, b = 0;
+    size_t i = 0;
+
+#if defined(WEAK_CHECKSUM_SSE2)
+    static const size_t STEP = 16;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weightsLow = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+    const __m128i weightsHigh = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+    __m128i sums = zero;        // Sum of the bytes in two 64-bit lanes
+    __m128i prefixes = zero;    // Sum of the sums before every step
+    __m128i weighted = zero;    // Weighted bytes of the steps in four 32-bit lanes, wrapping is harmless
+    for (; i + STEP <= len; i += STEP) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        prefixes = _mm_add_epi64(prefixes, sums);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(bytes, zero));
+        weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weightsLow));
+        weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weightsHigh));
+    }
+
+    const uint64_t sum = static_cast<uint64_t>(_mm_cvtsi128_si64(sums)) + static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums)));
+    const uint64_t prefix = static_cast<uint64_t>(_mm_cvtsi128_si64(prefixes)) + static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(prefixes, prefixes)));
+    weighted = _mm_add_epi32(weighted, _mm_shuffle_epi32(weighted, _MM_SHUFFLE(1, 0, 3, 2)));
+    weighted = _mm_add_epi32(weighted, _mm_shuffle_epi32(weighted, _MM_SHUFFLE(2, 3, 0, 1)));
+    a = static_cast<uint32_t>(sum);
+    b = static_cast<uint32_t>(prefix * STEP) + static_cast<uint32_t>(_mm_cvtsi128_si32(weighted));
+#endif
+
+    for (; i < len; ++i) {
+        a += data[i];
+        b += a;
+    }
+
+    WeakChecksum checksum;
+    checksum.a = a;
+    checksum.b = b;
+    checksum.length = static_cast<uint32_t>(len);
+    return checksum;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// WeakChecksum is the rolling checksum of rsync. For a window of n bytes x[0..n-1]
+// the low half is the sum of the bytes and the high half is the sum of x[i] * (n - i),
+// both modulo 2^16. Moving the window by one byte updates both halves in constant
+// time, so the checksum of every offset of a file is found in a single pass.
+// It is cheap to compute but easy to collide, so matches are confirmed by a strong hash.
+struct WeakChecksum
+{
+    static const size_t SIZE = 4;   // Size of the checksum in a hash record
+
+    uint32_t a = 0;     // Sums are kept modulo 2^32, only their low halves are used
+    uint32_t b = 0;
+    uint32_t length = 0;
+
+    // Computes the checksum of the window at the start of the data
+    static WeakChecksum Compute(const unsigned char* data, size_t len);
+
+    // Moves the window one byte forward, the first byte leaves it and the next one enters it
+    void Roll(unsigned char out, unsigned char in) {
+        a += static_cast<uint32_t>(in) - out;
+        b += a - length * out;
+    }
+
+    uint32_t Value() const {
+        return (a & 0xFFFF) | (b << 16);
+    }
+};
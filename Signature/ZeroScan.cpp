@@ -0,0 +1,42 @@
+#include "ZeroScan.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ZERO_SCAN_SSE2
+#endif
+
+bool IsZero(const unsigned char* data, size_t len)
+{
+    // Bytes up to the vector boundary are checked one by one, block buffers are already aligned
+    while (len > 0 && (reinterpret_cast<uintptr_t>(data) & 15) != 0) {
+        if (*data++) return false;
+        --len;
+    }
+
+#if defined(ZERO_SCAN_SSE2)
+    // Four cache lines are OR-ed together per check, the loop is bound by the memory bandwidth
+    static const size_t STEP = 256;
+    const __m128i zero = _mm_setzero_si128();
+    for (; len >= STEP; data += STEP, len -= STEP) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(data);
+        __m128i acc = zero;
+        for (int i = 0; i < 16; i += 4) {
+            acc = _mm_or_si128(acc, _mm_or_si128(_mm_or_si128(_mm_load_si128(p + i), _mm_load_si128(p + i + 1)),
+                _mm_or_si128(_mm_load_si128(p + i + 2), _mm_load_si128(p + i + 3))));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF) return false;
+    }
+#endif
+
+    for (; len >= sizeof(uint64_t); data += sizeof(uint64_t), len -= sizeof(uint64_t)) {
+        uint64_t v;
+        memcpy(&v, data, sizeof(v));
+        if (v) return false;
+    }
+    while (len--) {
+        if (*data++) return false;
+    }
+    return true;
+}
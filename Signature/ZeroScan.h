@@ -0,0 +1,6 @@
+#pragma once
+#include <stddef.h>
+
+// Checks whether all bytes of the buffer are zero. Buffers with data usually
+// differ from zero at the start, so the scan stops early for them.
+bool IsZero(const unsigned char* data, size_t len);
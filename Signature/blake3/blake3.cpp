@@ -0,0 +1,347 @@
+// Implementation of the BLAKE3 cryptographic hash function,
+// compatible with the reference implementation https://github.com/BLAKE3-team/BLAKE3
+// BLAKE3 is distributed under the CC0 1.0 Universal or the Apache License 2.0.
+
+#include "blake3.h"
+#include "blake3_impl.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <thread>
+#include <vector>
+
+#include <compat/cpuid.h>
+
+namespace blake3_sse41
+{
+void Hash4(const unsigned char* const inputs[4], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out);
+}
+
+namespace blake3_avx2
+{
+void Hash8(const unsigned char* const inputs[8], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out);
+}
+
+namespace blake3_avx512
+{
+void Hash16(const unsigned char* const inputs[16], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out);
+}
+
+// Internal implementation code.
+namespace
+{
+using namespace blake3;
+
+static const size_t MAX_SIMD_DEGREE = 16;
+static const size_t CHUNKS_PER_BLOCK = BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN;
+
+/** Chunks of a subtree hashed by a thread at once. Subtrees are the unit of work split between threads. */
+static const size_t SUBTREE_CHUNKS = 64;
+static const size_t SUBTREE_LEN = SUBTREE_CHUNKS * BLAKE3_CHUNK_LEN;
+
+/** Portable implementation. */
+namespace portable
+{
+uint32_t inline RotR(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+void inline G(uint32_t* v, size_t a, size_t b, size_t c, size_t d, uint32_t mx, uint32_t my)
+{
+    v[a] = v[a] + v[b] + mx;
+    v[d] = RotR(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = RotR(v[b] ^ v[c], 12);
+    v[a] = v[a] + v[b] + my;
+    v[d] = RotR(v[d] ^ v[a], 8);
+    v[c] = v[c] + v[d];
+    v[b] = RotR(v[b] ^ v[c], 7);
+}
+
+/** Compress a block into the chaining value. */
+void Compress(uint32_t cv[8], const unsigned char block[BLAKE3_BLOCK_LEN], uint32_t blockLen, uint64_t counter, uint8_t flags)
+{
+    uint32_t m[16];
+    for (size_t i = 0; i < 16; ++i) m[i] = Load32(block + 4 * i);
+
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), blockLen, flags,
+    };
+
+    for (size_t r = 0; r < 7; ++r) {
+        const uint8_t* s = MSG_SCHEDULE[r];
+        G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+        G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+        G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+        G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+        G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+        G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+        G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+
+    for (size_t i = 0; i < 8; ++i) cv[i] = v[i] ^ v[i + 8];
+}
+
+void HashOne(const unsigned char* input, size_t blocks, const uint32_t key[8], uint64_t counter,
+    uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out)
+{
+    uint32_t cv[8];
+    memcpy(cv, key, sizeof(cv));
+    uint8_t blockFlags = flags | flagsStart;
+    for (size_t b = 0; b < blocks; ++b) {
+        if (b + 1 == blocks) blockFlags |= flagsEnd;
+        Compress(cv, input + b * BLAKE3_BLOCK_LEN, BLAKE3_BLOCK_LEN, counter, blockFlags);
+        blockFlags = flags;
+    }
+    for (size_t i = 0; i < 8; ++i) Store32(out + 4 * i, cv[i]);
+}
+} // namespace portable
+
+// Kernels of the selected implementation, nullptr if not available
+HashManyType HashMany16 = nullptr;
+HashManyType HashMany8 = nullptr;
+HashManyType HashMany4 = nullptr;
+
+/** Hash count inputs with the widest kernels available, the rest one by one.
+ *  Every input is read before its chaining value is written, so out may overlap
+ *  the inputs as long as it does not run ahead of them.
+ */
+void HashMany(const unsigned char* const inputs[], size_t count, size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out)
+{
+    const HashManyType kernels[] = { HashMany16, HashMany8, HashMany4 };
+    const size_t degrees[] = { 16, 8, 4 };
+    for (size_t k = 0; k < 3; ++k) {
+        if (!kernels[k]) continue;
+        while (count >= degrees[k]) {
+            kernels[k](inputs, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out);
+            inputs += degrees[k];
+            out += degrees[k] * BLAKE3_OUT_LEN;
+            if (incrementCounter) counter += degrees[k];
+            count -= degrees[k];
+        }
+    }
+    for (; count > 0; --count) {
+        portable::HashOne(*inputs++, blocks, key, counter, flags, flagsStart, flagsEnd, out);
+        out += BLAKE3_OUT_LEN;
+        if (incrementCounter) ++counter;
+    }
+}
+
+/** Hash a chunk of up to 1024 bytes, its last block may be partial. */
+void HashChunk(const unsigned char* input, size_t len, uint64_t counter, uint8_t flags, unsigned char out[BLAKE3_OUT_LEN])
+{
+    uint32_t cv[8];
+    memcpy(cv, IV, sizeof(cv));
+    const size_t blocks = (len == 0) ? 1 : (len + BLAKE3_BLOCK_LEN - 1) / BLAKE3_BLOCK_LEN;
+    uint8_t blockFlags = CHUNK_START;
+    for (size_t b = 0; b < blocks; ++b) {
+        const size_t blockLen = (std::min)(BLAKE3_BLOCK_LEN, len - b * BLAKE3_BLOCK_LEN);
+        unsigned char block[BLAKE3_BLOCK_LEN] = { 0 };
+        memcpy(block, input + b * BLAKE3_BLOCK_LEN, blockLen);
+        if (b + 1 == blocks) blockFlags |= CHUNK_END | flags;
+        portable::Compress(cv, block, static_cast<uint32_t>(blockLen), counter, blockFlags);
+        blockFlags = 0;
+    }
+    for (size_t i = 0; i < 8; ++i) Store32(out + 4 * i, cv[i]);
+}
+
+/** Compute chaining values of all the chunks of the input, the first chunk has the given counter. */
+void HashChunks(const unsigned char* input, size_t len, uint64_t counter, unsigned char* cvs)
+{
+    const size_t fullChunks = len / BLAKE3_CHUNK_LEN;
+    const unsigned char* inputs[MAX_SIMD_DEGREE];
+    for (size_t first = 0; first < fullChunks; first += MAX_SIMD_DEGREE) {
+        const size_t count = (std::min)(MAX_SIMD_DEGREE, fullChunks - first);
+        for (size_t i = 0; i < count; ++i) inputs[i] = input + (first + i) * BLAKE3_CHUNK_LEN;
+        HashMany(inputs, count, CHUNKS_PER_BLOCK, IV, counter + first, true, 0, CHUNK_START, CHUNK_END, cvs + first * BLAKE3_OUT_LEN);
+    }
+    if (len % BLAKE3_CHUNK_LEN != 0) {
+        HashChunk(input + fullChunks * BLAKE3_CHUNK_LEN, len % BLAKE3_CHUNK_LEN, counter + fullChunks, 0, cvs + fullChunks * BLAKE3_OUT_LEN);
+    }
+}
+
+/** Merge chaining values of adjacent subtrees pairwise, an odd one is carried to the next level.
+ *  This builds the same left-balanced tree as the reference implementation. The last parent gets
+ *  the given flags. The buffer of chaining values is overwritten.
+ */
+void MergeSubtrees(unsigned char* cvs, size_t count, uint8_t flags, unsigned char out[BLAKE3_OUT_LEN])
+{
+    const unsigned char* inputs[MAX_SIMD_DEGREE];
+    while (count > 2) {
+        const size_t pairs = count / 2;
+        for (size_t first = 0; first < pairs; first += MAX_SIMD_DEGREE) {
+            const size_t batch = (std::min)(MAX_SIMD_DEGREE, pairs - first);
+            for (size_t i = 0; i < batch; ++i) inputs[i] = cvs + (first + i) * 2 * BLAKE3_OUT_LEN;
+            HashMany(inputs, batch, 1, IV, 0, false, PARENT, 0, 0, cvs + first * BLAKE3_OUT_LEN);
+        }
+        if (count % 2 != 0) {
+            memmove(cvs + pairs * BLAKE3_OUT_LEN, cvs + (count - 1) * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN);
+        }
+        count = pairs + count % 2;
+    }
+
+    if (count == 2) {
+        portable::HashOne(cvs, 1, IV, 0, PARENT | flags, 0, 0, out);
+    }
+    else {
+        memcpy(out, cvs, BLAKE3_OUT_LEN);
+    }
+}
+
+/** Compute the chaining value of a subtree of up to SUBTREE_CHUNKS chunks. */
+void HashSubtree(const unsigned char* input, size_t len, uint64_t counter, unsigned char out[BLAKE3_OUT_LEN])
+{
+    unsigned char cvs[SUBTREE_CHUNKS * BLAKE3_OUT_LEN];
+    const size_t chunks = (len + BLAKE3_CHUNK_LEN - 1) / BLAKE3_CHUNK_LEN;
+    HashChunks(input, len, counter, cvs);
+    MergeSubtrees(cvs, chunks, 0, out);
+}
+
+bool SelfTest()
+{
+    static const unsigned char ABC_HASH[BLAKE3_OUT_LEN] = {
+        0x64, 0x37, 0xb3, 0xac, 0x38, 0x46, 0x51, 0x33, 0xff, 0xb6, 0x3b, 0x75, 0x27, 0x3a, 0x8d, 0xb5,
+        0x48, 0xc5, 0x58, 0x46, 0x5d, 0x79, 0xdb, 0x03, 0xfd, 0x35, 0x9c, 0x6c, 0xd5, 0xbd, 0x9d, 0x85};
+
+    unsigned char out[BLAKE3_OUT_LEN];
+    HashChunk(reinterpret_cast<const unsigned char*>("abc"), 3, 0, ROOT, out);
+    if (memcmp(out, ABC_HASH, BLAKE3_OUT_LEN) != 0) return false;
+
+    // Every kernel must agree with the portable implementation
+    std::vector<unsigned char> data(MAX_SIMD_DEGREE * BLAKE3_CHUNK_LEN);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<unsigned char>(i % 251);
+    const unsigned char* inputs[MAX_SIMD_DEGREE];
+    for (size_t i = 0; i < MAX_SIMD_DEGREE; ++i) inputs[i] = data.data() + i * BLAKE3_CHUNK_LEN;
+
+    const HashManyType kernels[] = { HashMany16, HashMany8, HashMany4 };
+    const size_t degrees[] = { 16, 8, 4 };
+    for (size_t k = 0; k < 3; ++k) {
+        if (!kernels[k]) continue;
+        unsigned char simd[MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+        kernels[k](inputs, CHUNKS_PER_BLOCK, IV, 0x1FFFFFFFEULL, true, 0, CHUNK_START, CHUNK_END, simd);
+        for (size_t i = 0; i < degrees[k]; ++i) {
+            portable::HashOne(inputs[i], CHUNKS_PER_BLOCK, IV, 0x1FFFFFFFEULL + i, 0, CHUNK_START, CHUNK_END, out);
+            if (memcmp(out, simd + i * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN) != 0) return false;
+        }
+    }
+    return true;
+}
+
+#if defined(HAVE_GETCPUID)
+/** Read the XCR0 register, which tells the register states enabled by the OS. */
+uint32_t GetXCR0()
+{
+#if defined(_MSC_VER)
+    return (uint32_t)_xgetbv(0);
+#else
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return a;
+#endif
+}
+#endif
+} // namespace
+
+std::string BLAKE3AutoDetect()
+{
+    std::string ret;
+    HashMany16 = nullptr;
+    HashMany8 = nullptr;
+    HashMany4 = nullptr;
+#if defined(HAVE_GETCPUID)
+    bool have_sse41 = false;
+    bool have_avx2 = false;
+    bool have_avx512 = false;
+    bool enabled_avx = false;
+    bool enabled_avx512 = false;
+
+    (void)have_sse41;
+    (void)have_avx2;
+    (void)have_avx512;
+    (void)enabled_avx;
+    (void)enabled_avx512;
+
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    have_sse41 = (ecx >> 19) & 1;
+    if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) { // XSAVE and AVX
+        const uint32_t xcr0 = GetXCR0();
+        enabled_avx = (xcr0 & 6) == 6;
+        enabled_avx512 = (xcr0 & 0xE6) == 0xE6;
+    }
+    GetCPUID(0, 0, eax, ebx, ecx, edx);
+    if (eax >= 7) {
+        GetCPUID(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+        have_avx512 = (ebx >> 16) & 1; // AVX512F
+    }
+
+#if defined(ENABLE_SSE41)
+    if (have_sse41) {
+        HashMany4 = blake3_sse41::Hash4;
+        ret += ",sse41(4way)";
+    }
+#endif
+#if defined(ENABLE_AVX2)
+    if (have_avx2 && enabled_avx) {
+        HashMany8 = blake3_avx2::Hash8;
+        ret += ",avx2(8way)";
+    }
+#endif
+#if defined(ENABLE_AVX512)
+    if (have_avx512 && enabled_avx512) {
+        HashMany16 = blake3_avx512::Hash16;
+        ret += ",avx512(16way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret.empty() ? "portable" : ret.substr(1);
+}
+
+size_t BLAKE3SimdDegree()
+{
+    return HashMany16 ? 16 : HashMany8 ? 8 : HashMany4 ? 4 : 1;
+}
+
+void BLAKE3Hash(unsigned char output[BLAKE3_OUT_LEN], const unsigned char* input, size_t len, unsigned threads)
+{
+    if (len <= BLAKE3_CHUNK_LEN) {
+        HashChunk(input, len, 0, ROOT, output);
+        return;
+    }
+
+    const size_t chunks = (len + BLAKE3_CHUNK_LEN - 1) / BLAKE3_CHUNK_LEN;
+    if (chunks <= SUBTREE_CHUNKS) {
+        unsigned char cvs[SUBTREE_CHUNKS * BLAKE3_OUT_LEN];
+        HashChunks(input, len, 0, cvs);
+        MergeSubtrees(cvs, chunks, ROOT, output);
+        return;
+    }
+
+    // Aligned subtrees of a power of two chunks are nodes of the tree, so they are hashed independently
+    const size_t subtrees = (chunks + SUBTREE_CHUNKS - 1) / SUBTREE_CHUNKS;
+    std::vector<unsigned char> cvs(subtrees * BLAKE3_OUT_LEN);
+    auto hashRange = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const size_t offset = i * SUBTREE_LEN;
+            HashSubtree(input + offset, (std::min)(SUBTREE_LEN, len - offset), i * SUBTREE_CHUNKS, cvs.data() + i * BLAKE3_OUT_LEN);
+        }
+    };
+
+    const size_t parts = (std::max)(static_cast<size_t>(1), (std::min)(static_cast<size_t>(threads), subtrees));
+    std::vector<std::thread> helpers;
+    for (size_t p = 1; p < parts; ++p) {
+        helpers.emplace_back(hashRange, subtrees * p / parts, subtrees * (p + 1) / parts);
+    }
+    hashRange(0, subtrees / parts);
+    for (auto& h : helpers) h.join();
+
+    MergeSubtrees(cvs.data(), subtrees, ROOT, output);
+}
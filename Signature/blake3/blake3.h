@@ -0,0 +1,30 @@
+// Implementation of the BLAKE3 cryptographic hash function,
+// compatible with the reference implementation https://github.com/BLAKE3-team/BLAKE3
+// BLAKE3 is distributed under the CC0 1.0 Universal or the Apache License 2.0.
+
+#ifndef BLAKE3_H
+#define BLAKE3_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+static const size_t BLAKE3_OUT_LEN = 32;
+static const size_t BLAKE3_BLOCK_LEN = 64;
+static const size_t BLAKE3_CHUNK_LEN = 1024;
+
+/** Autodetect the best available BLAKE3 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string BLAKE3AutoDetect();
+
+/** Returns the number of chunks hashed in parallel by the selected implementation. */
+size_t BLAKE3SimdDegree();
+
+/** Compute the BLAKE3 hash of the input.
+ *  Inputs that span several subtrees are split between up to threads threads,
+ *  every thread hashes a contiguous range of subtrees.
+ */
+void BLAKE3Hash(unsigned char output[BLAKE3_OUT_LEN], const unsigned char* input, size_t len, unsigned threads = 1);
+
+#endif // BLAKE3_H
@@ -0,0 +1,102 @@
+// Implementation of the BLAKE3 cryptographic hash function,
+// compatible with the reference implementation https://github.com/BLAKE3-team/BLAKE3
+// BLAKE3 is distributed under the CC0 1.0 Universal or the Apache License 2.0.
+//
+// This is an 8-way AVX2 implementation hashing 8 inputs in parallel.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "blake3_impl.h"
+
+namespace blake3_avx2 {
+namespace {
+
+struct Ops
+{
+    typedef __m256i Vec;
+    static const size_t LANES = 8;
+
+    static BLAKE3_INLINE Vec Set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+    static BLAKE3_INLINE Vec Load(const uint32_t* p) { return _mm256_load_si256((const __m256i*)p); }
+    static BLAKE3_INLINE void Store(uint32_t* p, Vec x) { _mm256_store_si256((__m256i*)p, x); }
+    static BLAKE3_INLINE Vec Add(Vec x, Vec y) { return _mm256_add_epi32(x, y); }
+    static BLAKE3_INLINE Vec Xor(Vec x, Vec y) { return _mm256_xor_si256(x, y); }
+    static BLAKE3_INLINE Vec Rot16(Vec x)
+    {
+        return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                                      13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+    }
+    static BLAKE3_INLINE Vec Rot12(Vec x) { return _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20)); }
+    static BLAKE3_INLINE Vec Rot8(Vec x)
+    {
+        return _mm256_shuffle_epi8(x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+                                                      12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+    }
+    static BLAKE3_INLINE Vec Rot7(Vec x) { return _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25)); }
+
+    static BLAKE3_INLINE void G(Vec& a, Vec& b, Vec& c, Vec& d, Vec mx, Vec my)
+    {
+        a = Add(Add(a, b), mx);
+        d = Rot16(Xor(d, a));
+        c = Add(c, d);
+        b = Rot12(Xor(b, c));
+        a = Add(Add(a, b), my);
+        d = Rot8(Xor(d, a));
+        c = Add(c, d);
+        b = Rot7(Xor(b, c));
+    }
+
+    /** Load a block of every input, so that m[i] holds word i of all the inputs. */
+    static BLAKE3_INLINE void LoadMessage(Vec m[16], const unsigned char* const inputs[], size_t offset)
+    {
+        // Inputs are separate streams, so the blocks a few steps ahead are requested explicitly
+        for (size_t i = 0; i < LANES; ++i) _mm_prefetch((const char*)(inputs[i] + offset + 256), _MM_HINT_T0);
+
+        for (size_t half = 0; half < 2; ++half) {
+            __m256i r[8];
+            for (size_t i = 0; i < 8; ++i) r[i] = _mm256_loadu_si256((const __m256i*)(inputs[i] + offset + 32 * half));
+
+            // Transpose 8x8 words: 32-bit and 64-bit interleaving inside 128-bit lanes, then lanes exchange
+            const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+            const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+            const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+            const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+            const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+            const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+            const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+            const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+            const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+            const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+            const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+            const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+            const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+            const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+            const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+            const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+            Vec* w = m + 8 * half;
+            w[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+            w[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+            w[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+            w[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+            w[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+            w[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+            w[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+            w[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+        }
+    }
+};
+
+} // namespace
+
+void Hash8(const unsigned char* const inputs[8], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out)
+{
+    blake3::HashManyLanes<Ops>(inputs, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out);
+}
+
+} // namespace blake3_avx2
+
+#endif
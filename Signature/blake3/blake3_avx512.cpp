@@ -0,0 +1,88 @@
+// Implementation of the BLAKE3 cryptographic hash function,
+// compatible with the reference implementation https://github.com/BLAKE3-team/BLAKE3
+// BLAKE3 is distributed under the CC0 1.0 Universal or the Apache License 2.0.
+//
+// This is a 16-way AVX-512 implementation hashing 16 inputs in parallel.
+// It requires AVX512F, rotations are done with the native instruction.
+
+#ifdef ENABLE_AVX512
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "blake3_impl.h"
+
+namespace blake3_avx512 {
+namespace {
+
+struct Ops
+{
+    typedef __m512i Vec;
+    static const size_t LANES = 16;
+
+    static BLAKE3_INLINE Vec Set1(uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+    static BLAKE3_INLINE Vec Load(const uint32_t* p) { return _mm512_load_si512((const void*)p); }
+    static BLAKE3_INLINE void Store(uint32_t* p, Vec x) { _mm512_store_si512((void*)p, x); }
+    static BLAKE3_INLINE Vec Add(Vec x, Vec y) { return _mm512_add_epi32(x, y); }
+    static BLAKE3_INLINE Vec Xor(Vec x, Vec y) { return _mm512_xor_si512(x, y); }
+
+    static BLAKE3_INLINE void G(Vec& a, Vec& b, Vec& c, Vec& d, Vec mx, Vec my)
+    {
+        a = Add(Add(a, b), mx);
+        d = _mm512_ror_epi32(Xor(d, a), 16);
+        c = Add(c, d);
+        b = _mm512_ror_epi32(Xor(b, c), 12);
+        a = Add(Add(a, b), my);
+        d = _mm512_ror_epi32(Xor(d, a), 8);
+        c = Add(c, d);
+        b = _mm512_ror_epi32(Xor(b, c), 7);
+    }
+
+    /** Load a block of every input, so that m[i] holds word i of all the inputs. */
+    static BLAKE3_INLINE void LoadMessage(Vec m[16], const unsigned char* const inputs[], size_t offset)
+    {
+        // Inputs are separate streams, so the blocks a few steps ahead are requested explicitly
+        for (size_t i = 0; i < LANES; ++i) _mm_prefetch((const char*)(inputs[i] + offset + 256), _MM_HINT_T0);
+
+        // Interleaving inside 128-bit lanes leaves u[g][j] with word 4 * k + j of rows 4 * g .. 4 * g + 3 in lane k
+        __m512i u[4][4];
+        for (size_t g = 0; g < 4; ++g) {
+            const __m512i r0 = _mm512_loadu_si512((const void*)(inputs[4 * g + 0] + offset));
+            const __m512i r1 = _mm512_loadu_si512((const void*)(inputs[4 * g + 1] + offset));
+            const __m512i r2 = _mm512_loadu_si512((const void*)(inputs[4 * g + 2] + offset));
+            const __m512i r3 = _mm512_loadu_si512((const void*)(inputs[4 * g + 3] + offset));
+            const __m512i t0 = _mm512_unpacklo_epi32(r0, r1);
+            const __m512i t1 = _mm512_unpackhi_epi32(r0, r1);
+            const __m512i t2 = _mm512_unpacklo_epi32(r2, r3);
+            const __m512i t3 = _mm512_unpackhi_epi32(r2, r3);
+            u[g][0] = _mm512_unpacklo_epi64(t0, t2);
+            u[g][1] = _mm512_unpackhi_epi64(t0, t2);
+            u[g][2] = _mm512_unpacklo_epi64(t1, t3);
+            u[g][3] = _mm512_unpackhi_epi64(t1, t3);
+        }
+
+        // Transposing the 128-bit lanes of u[0..3][j] gathers word 4 * k + j of all the rows
+        for (size_t j = 0; j < 4; ++j) {
+            const __m512i a = _mm512_shuffle_i32x4(u[0][j], u[1][j], 0x44);
+            const __m512i b = _mm512_shuffle_i32x4(u[2][j], u[3][j], 0x44);
+            const __m512i c = _mm512_shuffle_i32x4(u[0][j], u[1][j], 0xEE);
+            const __m512i d = _mm512_shuffle_i32x4(u[2][j], u[3][j], 0xEE);
+            m[j] = _mm512_shuffle_i32x4(a, b, 0x88);
+            m[4 + j] = _mm512_shuffle_i32x4(a, b, 0xDD);
+            m[8 + j] = _mm512_shuffle_i32x4(c, d, 0x88);
+            m[12 + j] = _mm512_shuffle_i32x4(c, d, 0xDD);
+        }
+    }
+};
+
+} // namespace
+
+void Hash16(const unsigned char* const inputs[16], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out)
+{
+    blake3::HashManyLanes<Ops>(inputs, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out);
+}
+
+} // namespace blake3_avx512
+
+#endif
@@ -0,0 +1,137 @@
+// Internal definitions shared by the portable and SIMD implementations of BLAKE3.
+
+#ifndef BLAKE3_IMPL_H
+#define BLAKE3_IMPL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "blake3.h"
+
+/** Force inlining of the round functions, so that the state stays in registers. */
+#if defined(_MSC_VER)
+#define BLAKE3_INLINE __forceinline
+#else
+#define BLAKE3_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace blake3 {
+
+enum Flags : uint8_t {
+    CHUNK_START = 1 << 0,
+    CHUNK_END = 1 << 1,
+    PARENT = 1 << 2,
+    ROOT = 1 << 3,
+};
+
+static const uint32_t IV[8] = {0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+                               0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL};
+
+/** Message word order of every round, each row is the previous one permuted. */
+static const uint8_t MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+/** Hash several inputs of the same number of full blocks, writing a 32-byte chaining value per input.
+ *  inputs:           pointers to the inputs, blocks * 64 bytes each
+ *  key:              the initial chaining value of every input
+ *  counter:          the counter of the first input, incremented per input if incrementCounter is set
+ *  flags:            flags of every block, flagsStart and flagsEnd are added to the first and the last one
+ *  out:              pointer to a 32-byte output per input
+ */
+typedef void (*HashManyType)(const unsigned char* const inputs[], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out);
+
+// Input and output words are little endian, which is the native order of the supported platforms
+inline uint32_t Load32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void Store32(unsigned char* p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+template<typename Ops>
+BLAKE3_INLINE void Round(typename Ops::Vec v[16], const typename Ops::Vec m[16], size_t r)
+{
+    const uint8_t* s = MSG_SCHEDULE[r];
+    Ops::G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+    Ops::G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+    Ops::G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+    Ops::G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+    Ops::G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+    Ops::G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+    Ops::G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+    Ops::G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+}
+
+/** Compression shared by the SIMD kernels, Ops defines the vector type of LANES inputs and its operations. */
+template<typename Ops>
+void HashManyLanes(const unsigned char* const inputs[], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out)
+{
+    typedef typename Ops::Vec Vec;
+    static const size_t LANES = Ops::LANES;
+
+    alignas(64) uint32_t counterLow[LANES];
+    alignas(64) uint32_t counterHigh[LANES];
+    for (size_t i = 0; i < LANES; ++i) {
+        const uint64_t c = counter + (incrementCounter ? i : 0);
+        counterLow[i] = static_cast<uint32_t>(c);
+        counterHigh[i] = static_cast<uint32_t>(c >> 32);
+    }
+
+    Vec h[8];
+    for (size_t i = 0; i < 8; ++i) h[i] = Ops::Set1(key[i]);
+    const Vec ctrLow = Ops::Load(counterLow);
+    const Vec ctrHigh = Ops::Load(counterHigh);
+    const Vec blockLen = Ops::Set1(static_cast<uint32_t>(BLAKE3_BLOCK_LEN));
+
+    uint8_t blockFlags = flags | flagsStart;
+    for (size_t b = 0; b < blocks; ++b) {
+        if (b + 1 == blocks) blockFlags |= flagsEnd;
+
+        Vec m[16];
+        Ops::LoadMessage(m, inputs, b * BLAKE3_BLOCK_LEN);
+
+        Vec v[16] = {
+            h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+            Ops::Set1(IV[0]), Ops::Set1(IV[1]), Ops::Set1(IV[2]), Ops::Set1(IV[3]),
+            ctrLow, ctrHigh, blockLen, Ops::Set1(blockFlags),
+        };
+
+        // Rounds are unrolled, so message words are picked at compile time
+        Round<Ops>(v, m, 0);
+        Round<Ops>(v, m, 1);
+        Round<Ops>(v, m, 2);
+        Round<Ops>(v, m, 3);
+        Round<Ops>(v, m, 4);
+        Round<Ops>(v, m, 5);
+        Round<Ops>(v, m, 6);
+
+        for (size_t i = 0; i < 8; ++i) h[i] = Ops::Xor(v[i], v[i + 8]);
+        blockFlags = flags;
+    }
+
+    // Chaining values are spread over the lanes, gather every one of them back
+    alignas(64) uint32_t words[8][LANES];
+    for (size_t i = 0; i < 8; ++i) Ops::Store(words[i], h[i]);
+    for (size_t lane = 0; lane < LANES; ++lane) {
+        for (size_t i = 0; i < 8; ++i) Store32(out + lane * BLAKE3_OUT_LEN + 4 * i, words[i][lane]);
+    }
+}
+
+} // namespace blake3
+
+#endif // BLAKE3_IMPL_H
@@ -0,0 +1,77 @@
+// Implementation of the BLAKE3 cryptographic hash function,
+// compatible with the reference implementation https://github.com/BLAKE3-team/BLAKE3
+// BLAKE3 is distributed under the CC0 1.0 Universal or the Apache License 2.0.
+//
+// This is a 4-way SSE4.1 implementation hashing 4 inputs in parallel.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "blake3_impl.h"
+
+namespace blake3_sse41 {
+namespace {
+
+struct Ops
+{
+    typedef __m128i Vec;
+    static const size_t LANES = 4;
+
+    static BLAKE3_INLINE Vec Set1(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+    static BLAKE3_INLINE Vec Load(const uint32_t* p) { return _mm_load_si128((const __m128i*)p); }
+    static BLAKE3_INLINE void Store(uint32_t* p, Vec x) { _mm_store_si128((__m128i*)p, x); }
+    static BLAKE3_INLINE Vec Add(Vec x, Vec y) { return _mm_add_epi32(x, y); }
+    static BLAKE3_INLINE Vec Xor(Vec x, Vec y) { return _mm_xor_si128(x, y); }
+    static BLAKE3_INLINE Vec Rot16(Vec x) { return _mm_shuffle_epi8(x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2)); }
+    static BLAKE3_INLINE Vec Rot12(Vec x) { return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 20)); }
+    static BLAKE3_INLINE Vec Rot8(Vec x) { return _mm_shuffle_epi8(x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1)); }
+    static BLAKE3_INLINE Vec Rot7(Vec x) { return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25)); }
+
+    static BLAKE3_INLINE void G(Vec& a, Vec& b, Vec& c, Vec& d, Vec mx, Vec my)
+    {
+        a = Add(Add(a, b), mx);
+        d = Rot16(Xor(d, a));
+        c = Add(c, d);
+        b = Rot12(Xor(b, c));
+        a = Add(Add(a, b), my);
+        d = Rot8(Xor(d, a));
+        c = Add(c, d);
+        b = Rot7(Xor(b, c));
+    }
+
+    /** Load a block of every input, so that m[i] holds word i of all the inputs. */
+    static BLAKE3_INLINE void LoadMessage(Vec m[16], const unsigned char* const inputs[], size_t offset)
+    {
+        // Inputs are separate streams, so the blocks a few steps ahead are requested explicitly
+        for (size_t i = 0; i < LANES; ++i) _mm_prefetch((const char*)(inputs[i] + offset + 256), _MM_HINT_T0);
+
+        for (size_t q = 0; q < 4; ++q) {
+            const __m128i r0 = _mm_loadu_si128((const __m128i*)(inputs[0] + offset + 16 * q));
+            const __m128i r1 = _mm_loadu_si128((const __m128i*)(inputs[1] + offset + 16 * q));
+            const __m128i r2 = _mm_loadu_si128((const __m128i*)(inputs[2] + offset + 16 * q));
+            const __m128i r3 = _mm_loadu_si128((const __m128i*)(inputs[3] + offset + 16 * q));
+            const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            const __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+            const __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+            const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+            m[4 * q + 0] = _mm_unpacklo_epi64(t0, t2);
+            m[4 * q + 1] = _mm_unpackhi_epi64(t0, t2);
+            m[4 * q + 2] = _mm_unpacklo_epi64(t1, t3);
+            m[4 * q + 3] = _mm_unpackhi_epi64(t1, t3);
+        }
+    }
+};
+
+} // namespace
+
+void Hash4(const unsigned char* const inputs[4], size_t blocks, const uint32_t key[8], uint64_t counter,
+    bool incrementCounter, uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd, unsigned char* out)
+{
+    blake3::HashManyLanes<Ops>(inputs, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out);
+}
+
+} // namespace blake3_sse41
+
+#endif
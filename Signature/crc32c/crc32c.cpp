@@ -0,0 +1,148 @@
+// Implementation of the CRC-32C (Castagnoli) checksum,
+// compatible with the SSE4.2 crc32 instruction and iSCSI (RFC 3720).
+
+#include "crc32c.h"
+#include "crc32c_impl.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <compat/cpuid.h>
+
+#if defined(ENABLE_SSE42)
+namespace crc32c_sse42
+{
+void Init();
+uint32_t Extend(uint32_t crc, const unsigned char* data, size_t len);
+}
+#endif
+
+namespace crc32c
+{
+namespace
+{
+// Slicing-by-8 tables, table[k] extends the register by a byte followed by k zero bytes
+struct SliceTables
+{
+    uint32_t table[8][256];
+
+    SliceTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const SliceTables slice;
+
+uint32_t ExtendPortable(uint32_t crc, const unsigned char* data, size_t len)
+{
+    const uint32_t(&t)[8][256] = slice.table;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, data, sizeof(v));
+        v ^= crc;
+        crc = t[7][v & 0xFF] ^ t[6][(v >> 8) & 0xFF] ^ t[5][(v >> 16) & 0xFF] ^ t[4][(v >> 24) & 0xFF] ^
+            t[3][(v >> 32) & 0xFF] ^ t[2][(v >> 40) & 0xFF] ^ t[1][(v >> 48) & 0xFF] ^ t[0][v >> 56];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+ExtendType Extend = ExtendPortable;
+
+/** Multiply polynomials a and b modulo the polynomial, bit 31 holds x^0. */
+uint32_t MultModP(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for (uint32_t m = 1U << 31; m != 0; m >>= 1) {
+        if (a & m) product ^= b;
+        b = (b & 1) ? (b >> 1) ^ POLY : b >> 1;
+    }
+    return product;
+}
+
+/** Returns x^n modulo the polynomial. */
+uint32_t XPowModP(uint64_t n)
+{
+    uint32_t power = 1U << 31;  // x^0
+    uint32_t square = 1U << 30; // x^1
+    while (n) {
+        if (n & 1) power = MultModP(square, power);
+        square = MultModP(square, square);
+        n >>= 1;
+    }
+    return power;
+}
+
+bool SelfTest()
+{
+    // Check value of the iSCSI specification
+    static const char check[] = "123456789";
+    if (CRC32C(check, sizeof(check) - 1) != 0xE3069283) return false;
+
+    // Compare the selected implementation with the portable one at every length and alignment of the stripes
+    static unsigned char data[3 * 8192 + 1024];
+    for (size_t i = 0; i < sizeof(data); ++i) data[i] = static_cast<unsigned char>(i * 7 + (i >> 8));
+    for (size_t len = 0; len <= sizeof(data); len += (len < 1024) ? 1 : 509) {
+        for (size_t offset = 0; offset < 8 && offset <= len; offset += 3) {
+            if (Extend(~0U, data + offset, len - offset) != ExtendPortable(~0U, data + offset, len - offset)) return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+void ShiftTable::Init(size_t len)
+{
+    const uint32_t op = XPowModP(8 * static_cast<uint64_t>(len));
+    for (uint32_t k = 0; k < 4; ++k) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            table[k][i] = MultModP(op, i << (8 * k));
+        }
+    }
+}
+} // namespace crc32c
+
+std::string CRC32CAutoDetect()
+{
+    std::string ret = "portable(slice8)";
+    crc32c::Extend = crc32c::ExtendPortable;
+#if defined(HAVE_GETCPUID) && defined(ENABLE_SSE42)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    if ((ecx >> 20) & 1) { // SSE4.2
+        crc32c_sse42::Init();
+        crc32c::Extend = crc32c_sse42::Extend;
+        ret = "sse42(3way)";
+    }
+#endif
+
+    assert(crc32c::SelfTest());
+    return ret;
+}
+
+uint32_t CRC32C(const void* input, size_t len, uint32_t crc)
+{
+    return ~crc32c::Extend(~crc, static_cast<const unsigned char*>(input), len);
+}
+
+void CRC32C_canonicalFromHash(unsigned char dst[CRC32C_OUT_LEN], uint32_t crc)
+{
+    for (int i = 0; i < 4; ++i) {
+        dst[i] = static_cast<unsigned char>(crc >> (24 - 8 * i));
+    }
+}
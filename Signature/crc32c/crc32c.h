@@ -0,0 +1,24 @@
+// Implementation of the CRC-32C (Castagnoli) checksum,
+// compatible with the SSE4.2 crc32 instruction and iSCSI (RFC 3720).
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+static const size_t CRC32C_OUT_LEN = 4;
+
+/** Autodetect the best available CRC-32C implementation.
+ *  Returns the name of the implementation.
+ */
+std::string CRC32CAutoDetect();
+
+/** Compute the CRC-32C of the input, extending the checksum crc of the preceding data. */
+uint32_t CRC32C(const void* input, size_t len, uint32_t crc = 0);
+
+/** Writes the checksum in big endian order. */
+void CRC32C_canonicalFromHash(unsigned char dst[CRC32C_OUT_LEN], uint32_t crc);
+
+#endif // CRC32C_H
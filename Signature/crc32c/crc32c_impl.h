@@ -0,0 +1,32 @@
+// Implementation of the CRC-32C (Castagnoli) checksum,
+// compatible with the SSE4.2 crc32 instruction and iSCSI (RFC 3720).
+
+#ifndef CRC32C_IMPL_H
+#define CRC32C_IMPL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace crc32c
+{
+// Reversed Castagnoli polynomial
+static const uint32_t POLY = 0x82F63B78;
+
+// Extends the raw register value, which is not inverted before and after the data
+typedef uint32_t (*ExtendType)(uint32_t crc, const unsigned char* data, size_t len);
+
+// Tables multiplying the register by x^(8*len) modulo the polynomial one byte of the register at a time,
+// which is the same as feeding len zero bytes. They combine checksums of adjacent data ranges.
+struct ShiftTable
+{
+    uint32_t table[4][256];
+
+    void Init(size_t len);
+
+    uint32_t Shift(uint32_t crc) const {
+        return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+    }
+};
+} // namespace crc32c
+
+#endif // CRC32C_IMPL_H
@@ -0,0 +1,83 @@
+// Implementation of the CRC-32C (Castagnoli) checksum,
+// compatible with the SSE4.2 crc32 instruction and iSCSI (RFC 3720).
+
+#ifdef ENABLE_SSE42
+
+#include "crc32c_impl.h"
+
+#include <string.h>
+#include <nmmintrin.h>
+
+namespace crc32c_sse42
+{
+namespace
+{
+// The crc32 instruction has a latency of three cycles and a throughput of one, so three
+// independent ranges are checksummed at once and combined by shifting their registers.
+// Long stripes amortize the combining, short ones handle the rest of medium inputs.
+const size_t LONG_STRIPE = 8192;
+const size_t SHORT_STRIPE = 256;
+
+crc32c::ShiftTable longShift;
+crc32c::ShiftTable shortShift;
+
+inline uint64_t Read64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template<size_t STRIPE>
+inline uint64_t Extend3Way(uint64_t crc0, const unsigned char*& data, size_t& len, const crc32c::ShiftTable& shift)
+{
+    while (len >= 3 * STRIPE) {
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+        const unsigned char* const end = data + STRIPE;
+        do {
+            crc0 = _mm_crc32_u64(crc0, Read64(data));
+            crc1 = _mm_crc32_u64(crc1, Read64(data + STRIPE));
+            crc2 = _mm_crc32_u64(crc2, Read64(data + 2 * STRIPE));
+            data += 8;
+        } while (data < end);
+        crc0 = shift.Shift(static_cast<uint32_t>(crc0)) ^ crc1;
+        crc0 = shift.Shift(static_cast<uint32_t>(crc0)) ^ crc2;
+        data += 2 * STRIPE;
+        len -= 3 * STRIPE;
+    }
+    return crc0;
+}
+} // namespace
+
+void Init()
+{
+    longShift.Init(LONG_STRIPE);
+    shortShift.Init(SHORT_STRIPE);
+}
+
+uint32_t Extend(uint32_t crc, const unsigned char* data, size_t len)
+{
+    while (len && (reinterpret_cast<uintptr_t>(data) & 7)) {
+        crc = _mm_crc32_u8(crc, *data++);
+        --len;
+    }
+
+    uint64_t crc0 = crc;
+    crc0 = Extend3Way<LONG_STRIPE>(crc0, data, len, longShift);
+    crc0 = Extend3Way<SHORT_STRIPE>(crc0, data, len, shortShift);
+    while (len >= 8) {
+        crc0 = _mm_crc32_u64(crc0, Read64(data));
+        data += 8;
+        len -= 8;
+    }
+
+    crc = static_cast<uint32_t>(crc0);
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+} // namespace crc32c_sse42
+
+#endif
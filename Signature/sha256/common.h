@@ -14,6 +14,13 @@
 
 #include <compat/endian.h>
 
+/** Force inlining of the small SIMD helpers used by the vectorized transforms. */
+#if defined(_MSC_VER)
+#define ALWAYS_INLINE __forceinline
+#else
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
 uint16_t static inline ReadLE16(const unsigned char* ptr)
 {
     uint16_t x;
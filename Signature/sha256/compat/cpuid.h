@@ -20,5 +20,20 @@ void static inline GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32
 #endif
 }
 
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define HAVE_GETCPUID
+
+#include <intrin.h>
+
+void static inline GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+    int regs[4];
+    __cpuidex(regs, (int)leaf, (int)subleaf);
+    a = (uint32_t)regs[0];
+    b = (uint32_t)regs[1];
+    c = (uint32_t)regs[2];
+    d = (uint32_t)regs[3];
+}
+
 #endif // defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
 #endif // BITCOIN_COMPAT_CPUID_H
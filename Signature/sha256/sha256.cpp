@@ -5,6 +5,7 @@
 #include <sha256.h>
 #include <common.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 
@@ -29,6 +30,21 @@ namespace sha256d64_avx2
 void Transform_8way(unsigned char* out, const unsigned char* in);
 }
 
+namespace sha256_avx2
+{
+void Transform_8way(uint32_t* s, const unsigned char* const chunks[8], size_t blocks);
+}
+
+namespace sha256d64_avx512
+{
+void Transform_16way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256_avx512
+{
+void Transform_16way(uint32_t* s, const unsigned char* const chunks[16], size_t blocks);
+}
+
 namespace sha256d64_shani
 {
 void Transform_2way(unsigned char* out, const unsigned char* in);
@@ -37,6 +53,7 @@ void Transform_2way(unsigned char* out, const unsigned char* in);
 namespace sha256_shani
 {
 void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+void Transform_2way(uint32_t* s, const unsigned char* const chunks[2], size_t blocks);
 }
 
 // Internal implementation code.
@@ -416,6 +433,7 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+typedef void (*TransformMultiType)(uint32_t*, const unsigned char* const*, size_t);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -461,6 +479,32 @@ TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformD64Type TransformD64_16way = nullptr;
+TransformMultiType TransformMulti = nullptr;
+size_t TransformMultiLanes = 1;
+
+/** Test a multi-stream transform against the single stream Transform. */
+bool SelfTestMulti(TransformMultiType tr, size_t lanes, const unsigned char* data)
+{
+    static const size_t MAX_LANES = 16;
+    assert(lanes <= MAX_LANES);
+    // Lanes start at different offsets, so mixed up lanes are detected
+    const unsigned char* chunks[MAX_LANES];
+    for (size_t j = 0; j < lanes; ++j) chunks[j] = data + 64 * (j % 6);
+
+    for (size_t i = 0; i <= 4; ++i) {
+        uint32_t states[8 * MAX_LANES];
+        for (size_t j = 0; j < lanes; ++j) sha256::Initialize(states + 8 * j);
+        tr(states, chunks, i);
+        for (size_t j = 0; j < lanes; ++j) {
+            uint32_t expected[8];
+            sha256::Initialize(expected);
+            Transform(expected, chunks[j], i);
+            if (!std::equal(expected, expected + 8, states + 8 * j)) return false;
+        }
+    }
+    return true;
+}
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -544,31 +588,73 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // Test TransformD64_16way, if available. Messages are tested twice to fill all the lanes.
+    if (TransformD64_16way) {
+        unsigned char in[1024];
+        unsigned char out[512];
+        memcpy(in, data + 1, 512);
+        memcpy(in + 512, data + 1, 512);
+        TransformD64_16way(out, in);
+        if (!std::equal(out, out + 256, result_d64)) return false;
+        if (!std::equal(out + 256, out + 512, result_d64)) return false;
+    }
+
+    // Test TransformMulti, if available.
+    if (TransformMulti) {
+        if (!SelfTestMulti(TransformMulti, TransformMultiLanes, data + 1)) return false;
+    }
+
     return true;
 }
 
-#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
-/** Check whether the OS has enabled AVX registers. */
-bool AVXEnabled()
+#if defined(HAVE_GETCPUID)
+/** Read the XCR0 register, which tells the register states enabled by the OS. */
+uint32_t GetXCR0()
 {
+#if defined(_MSC_VER)
+    return (uint32_t)_xgetbv(0);
+#else
     uint32_t a, d;
     __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
-    return (a & 6) == 6;
+    return a;
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    return (GetXCR0() & 6) == 6;
+}
+
+/** Check whether the OS has enabled AVX-512 registers and opmask. */
+bool AVX512Enabled()
+{
+    return (GetXCR0() & 0xE6) == 0xE6;
 }
 #endif
 } // namespace
 
 
-std::string SHA256AutoDetect()
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation)
 {
     std::string ret = "standard";
-#if defined(USE_ASM) && defined(HAVE_GETCPUID)
+    Transform = sha256::Transform;
+    TransformD64 = sha256::TransformD64;
+    TransformD64_2way = nullptr;
+    TransformD64_4way = nullptr;
+    TransformD64_8way = nullptr;
+    TransformD64_16way = nullptr;
+    TransformMulti = nullptr;
+    TransformMultiLanes = 1;
+#if defined(HAVE_GETCPUID)
     bool have_sse4 = false;
     bool have_xsave = false;
     bool have_avx = false;
     bool have_avx2 = false;
     bool have_shani = false;
+    bool have_avx512 = false;
     bool enabled_avx = false;
+    bool enabled_avx512 = false;
 
     (void)AVXEnabled;
     (void)have_sse4;
@@ -577,6 +663,9 @@ std::string SHA256AutoDetect()
     (void)have_avx2;
     (void)have_shani;
     (void)enabled_avx;
+    (void)AVX512Enabled;
+    (void)have_avx512;
+    (void)enabled_avx512;
 
     uint32_t eax, ebx, ecx, edx;
     GetCPUID(1, 0, eax, ebx, ecx, edx);
@@ -585,26 +674,35 @@ std::string SHA256AutoDetect()
     have_avx = (ecx >> 28) & 1;
     if (have_xsave && have_avx) {
         enabled_avx = AVXEnabled();
+        enabled_avx512 = AVX512Enabled();
     }
     if (have_sse4) {
         GetCPUID(7, 0, eax, ebx, ecx, edx);
         have_avx2 = (ebx >> 5) & 1;
         have_shani = (ebx >> 29) & 1;
+        have_avx512 = ((ebx >> 16) & 1) && ((ebx >> 31) & 1); // AVX512F and AVX512VL
     }
 
+    if (!(use_implementation & sha256_implementation::USE_SHANI)) have_shani = false;
+    if (!(use_implementation & sha256_implementation::USE_AVX512)) have_avx512 = false;
+    if (!(use_implementation & sha256_implementation::USE_AVX2)) have_avx2 = false;
+    if (!(use_implementation & sha256_implementation::USE_SSE4)) have_sse4 = false;
+
 #if defined(ENABLE_SHANI) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_shani) {
         Transform = sha256_shani::Transform;
         TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
         TransformD64_2way = sha256d64_shani::Transform_2way;
-        ret = "shani(1way,2way)";
+        TransformMulti = sha256_shani::Transform_2way;
+        TransformMultiLanes = 2;
+        ret = "shani(1way,2way,multi2)";
         have_sse4 = false; // Disable SSE4/AVX2;
         have_avx2 = false;
     }
 #endif
 
     if (have_sse4) {
-#if defined(__x86_64__) || defined(__amd64__)
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
         Transform = sha256_sse4::Transform;
         TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
         ret = "sse4(1way)";
@@ -618,7 +716,18 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
-        ret += ",avx2(8way)";
+        TransformMulti = sha256_avx2::Transform_8way;
+        TransformMultiLanes = 8;
+        ret += ",avx2(8way,multi8)";
+    }
+#endif
+
+#if defined(ENABLE_AVX512) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx512 && enabled_avx512) {
+        TransformD64_16way = sha256d64_avx512::Transform_16way;
+        TransformMulti = sha256_avx512::Transform_16way;
+        TransformMultiLanes = 16;
+        ret += ",avx512(16way,multi16)";
     }
 #endif
 #endif
@@ -686,6 +795,14 @@ CSHA256& CSHA256::Reset()
 
 void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
 {
+    if (TransformD64_16way) {
+        while (blocks >= 16) {
+            TransformD64_16way(out, in);
+            out += 512;
+            in += 1024;
+            blocks -= 16;
+        }
+    }
     if (TransformD64_8way) {
         while (blocks >= 8) {
             TransformD64_8way(out, in);
@@ -717,3 +834,57 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+size_t SHA256MultiLanes()
+{
+    return TransformMulti ? TransformMultiLanes : 1;
+}
+
+void SHA256Multi(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len)
+{
+    static const size_t MAX_LANES = 16;
+    // Below this number of messages the unused lanes cost more than sequential hashing
+    static const size_t MIN_LANES_USED = 3;
+
+    while (count > 0) {
+        const size_t lanes = TransformMultiLanes;
+        if (!TransformMulti || count < std::min(MIN_LANES_USED, lanes)) {
+            for (size_t i = 0; i < count; ++i) {
+                CSHA256().Write(inputs[i], len).Finalize(outputs[i]);
+            }
+            return;
+        }
+
+        // Unused lanes repeat the first message and their results are dropped
+        const size_t used = std::min(count, lanes);
+        const unsigned char* chunks[MAX_LANES];
+        for (size_t j = 0; j < lanes; ++j) chunks[j] = inputs[j < used ? j : 0];
+
+        uint32_t states[8 * MAX_LANES];
+        for (size_t j = 0; j < lanes; ++j) sha256::Initialize(states + 8 * j);
+
+        const size_t blocks = len / 64;
+        TransformMulti(states, chunks, blocks);
+
+        // Messages have equal length, so every lane ends with the same padding layout
+        const size_t rem = len % 64;
+        const size_t tailBlocks = (rem < 56) ? 1 : 2;
+        unsigned char tails[MAX_LANES][128];
+        for (size_t j = 0; j < lanes; ++j) {
+            memset(tails[j], 0, sizeof(tails[j]));
+            memcpy(tails[j], chunks[j] + blocks * 64, rem);
+            tails[j][rem] = 0x80;
+            WriteBE64(tails[j] + tailBlocks * 64 - 8, static_cast<uint64_t>(len) << 3);
+            chunks[j] = tails[j];
+        }
+        TransformMulti(states, chunks, tailBlocks);
+
+        for (size_t j = 0; j < used; ++j) {
+            for (size_t k = 0; k < 8; ++k) WriteBE32(outputs[j] + 4 * k, states[8 * j + k]);
+        }
+
+        outputs += used;
+        inputs += used;
+        count -= used;
+    }
+}
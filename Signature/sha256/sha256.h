@@ -26,10 +26,26 @@ public:
     CSHA256& Reset();
 };
 
+namespace sha256_implementation {
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_SSE4 = 1 << 0,
+    USE_AVX2 = 1 << 1,
+    USE_SHANI = 1 << 2,
+    USE_AVX512 = 1 << 3,
+    USE_SSE4_AND_AVX2 = USE_SSE4 | USE_AVX2,
+    USE_SSE4_AND_SHANI = USE_SSE4 | USE_SHANI,
+    USE_SSE4_AND_AVX512 = USE_SSE4 | USE_AVX512,
+    USE_ALL = USE_SSE4 | USE_AVX2 | USE_SHANI | USE_AVX512,
+};
+}
+
 /** Autodetect the best available SHA256 implementation.
+ *  Only the implementations allowed by use_implementation are considered,
+ *  which allows forcing a particular kernel. May be called again to switch.
  *  Returns the name of the implementation.
  */
-std::string SHA256AutoDetect();
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL);
 
 /** Compute multiple double-SHA256's of 64-byte blobs.
  *  output:  pointer to a blocks*32 byte output buffer
@@ -38,4 +54,17 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+/** Compute SHA256 hashes of multiple independent messages of equal length.
+ *  Messages are hashed in parallel lanes when a multi-stream implementation
+ *  is available, see SHA256MultiLanes.
+ *  outputs: pointers to count 32-byte output buffers
+ *  inputs:  pointers to count len-byte messages
+ *  count:   the number of messages
+ *  len:     the length of every message
+ */
+void SHA256Multi(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len);
+
+/** Returns the number of messages SHA256Multi hashes at once, 1 if no multi-stream implementation is available. */
+size_t SHA256MultiLanes();
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -36,7 +36,7 @@ __m256i inline sigma0(__m256i x) { return Xor(Or(ShR(x, 7), ShL(x, 25)), Or(ShR(
 __m256i inline sigma1(__m256i x) { return Xor(Or(ShR(x, 17), ShL(x, 15)), Or(ShR(x, 19), ShL(x, 13)), ShR(x, 10)); }
 
 /** One round of SHA-256. */
-void inline __attribute__((always_inline)) Round(__m256i a, __m256i b, __m256i c, __m256i& d, __m256i e, __m256i f, __m256i g, __m256i& h, __m256i k)
+void ALWAYS_INLINE Round(__m256i a, __m256i b, __m256i c, __m256i& d, __m256i e, __m256i f, __m256i g, __m256i& h, __m256i k)
 {
     __m256i t1 = Add(h, Sigma1(e), Ch(e, f, g), k);
     __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
@@ -325,4 +325,93 @@ void Transform_8way(unsigned char* out, const unsigned char* in)
 
 }
 
+namespace sha256_avx2 {
+using namespace sha256d64_avx2; // Shares the vector helpers
+namespace {
+
+const uint32_t KS[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul,
+};
+
+/** Read a big endian word at the given offset of every lane. */
+__m256i inline ReadLanes(const unsigned char* const chunks[8], size_t offset) {
+    return _mm256_set_epi32(
+        ReadBE32(chunks[7] + offset),
+        ReadBE32(chunks[6] + offset),
+        ReadBE32(chunks[5] + offset),
+        ReadBE32(chunks[4] + offset),
+        ReadBE32(chunks[3] + offset),
+        ReadBE32(chunks[2] + offset),
+        ReadBE32(chunks[1] + offset),
+        ReadBE32(chunks[0] + offset)
+    );
+}
+
+/** Word i of the message schedule, computed in place for rounds 16 and above. */
+__m256i inline Schedule(__m256i* w, int i) {
+    if (i < 16) return w[i];
+    return Inc(w[i & 15], sigma1(w[(i - 2) & 15]), w[(i - 7) & 15], sigma0(w[(i - 15) & 15]));
+}
+
+}
+
+/** Perform a number of SHA-256 transformations on 8 independent streams.
+ *  s:      8 lanes of 8-word states, the state of lane i starts at s + 8 * i
+ *  chunks: pointers to the first 64-byte chunk of every lane
+ *  blocks: number of consecutive chunks to process in every lane
+ */
+void Transform_8way(uint32_t* s, const unsigned char* const chunks[8], size_t blocks)
+{
+    __m256i state[8];
+    for (int j = 0; j < 8; ++j) {
+        state[j] = _mm256_set_epi32(s[56 + j], s[48 + j], s[40 + j], s[32 + j], s[24 + j], s[16 + j], s[8 + j], s[j]);
+    }
+
+    const unsigned char* in[8];
+    for (int i = 0; i < 8; ++i) in[i] = chunks[i];
+
+    while (blocks--) {
+        __m256i a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+        __m256i w[16];
+        for (int i = 0; i < 16; ++i) w[i] = ReadLanes(in, 4 * i);
+
+        for (int i = 0; i < 64; i += 8) {
+            Round(a, b, c, d, e, f, g, h, Add(K(KS[i + 0]), Schedule(w, i + 0)));
+            Round(h, a, b, c, d, e, f, g, Add(K(KS[i + 1]), Schedule(w, i + 1)));
+            Round(g, h, a, b, c, d, e, f, Add(K(KS[i + 2]), Schedule(w, i + 2)));
+            Round(f, g, h, a, b, c, d, e, Add(K(KS[i + 3]), Schedule(w, i + 3)));
+            Round(e, f, g, h, a, b, c, d, Add(K(KS[i + 4]), Schedule(w, i + 4)));
+            Round(d, e, f, g, h, a, b, c, Add(K(KS[i + 5]), Schedule(w, i + 5)));
+            Round(c, d, e, f, g, h, a, b, Add(K(KS[i + 6]), Schedule(w, i + 6)));
+            Round(b, c, d, e, f, g, h, a, Add(K(KS[i + 7]), Schedule(w, i + 7)));
+        }
+
+        state[0] = Add(state[0], a);
+        state[1] = Add(state[1], b);
+        state[2] = Add(state[2], c);
+        state[3] = Add(state[3], d);
+        state[4] = Add(state[4], e);
+        state[5] = Add(state[5], f);
+        state[6] = Add(state[6], g);
+        state[7] = Add(state[7], h);
+
+        for (int i = 0; i < 8; ++i) in[i] += 64;
+    }
+
+    for (int j = 0; j < 8; ++j) {
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), state[j]);
+        for (int i = 0; i < 8; ++i) s[8 * i + j] = lanes[i];
+    }
+}
+
+}
+
 #endif
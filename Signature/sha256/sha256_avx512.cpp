@@ -0,0 +1,178 @@
+// 16-lane AVX-512 SHA-256 kernels for multi-buffer hashing and SHA256D64.
+// The rounds follow the 8-way AVX2 kernels of sha256_avx2.cpp, which come from
+// Bitcoin Core (Copyright (c) 2017-2019 The Bitcoin Core developers) and are
+// distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX512
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <common.h>
+
+namespace {
+
+__m512i inline K(uint32_t x) { return _mm512_set1_epi32(x); }
+
+__m512i inline Add(__m512i x, __m512i y) { return _mm512_add_epi32(x, y); }
+__m512i inline Add(__m512i x, __m512i y, __m512i z) { return Add(Add(x, y), z); }
+__m512i inline Add(__m512i x, __m512i y, __m512i z, __m512i w) { return Add(Add(x, y), Add(z, w)); }
+__m512i inline Inc(__m512i& x, __m512i y, __m512i z, __m512i w) { x = Add(x, y, z, w); return x; }
+__m512i inline Xor(__m512i x, __m512i y, __m512i z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+__m512i inline RotR(__m512i x, int n) { return _mm512_ror_epi32(x, n); }
+__m512i inline ShR(__m512i x, int n) { return _mm512_srli_epi32(x, n); }
+
+__m512i inline Ch(__m512i x, __m512i y, __m512i z) { return _mm512_ternarylogic_epi32(x, y, z, 0xCA); }
+__m512i inline Maj(__m512i x, __m512i y, __m512i z) { return _mm512_ternarylogic_epi32(x, y, z, 0xE8); }
+__m512i inline Sigma0(__m512i x) { return Xor(RotR(x, 2), RotR(x, 13), RotR(x, 22)); }
+__m512i inline Sigma1(__m512i x) { return Xor(RotR(x, 6), RotR(x, 11), RotR(x, 25)); }
+__m512i inline sigma0(__m512i x) { return Xor(RotR(x, 7), RotR(x, 18), ShR(x, 3)); }
+__m512i inline sigma1(__m512i x) { return Xor(RotR(x, 17), RotR(x, 19), ShR(x, 10)); }
+
+const uint32_t KS[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul,
+};
+
+const uint32_t INIT[8] = {
+    0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul
+};
+
+/** One round of SHA-256. */
+void inline Round(__m512i a, __m512i b, __m512i c, __m512i& d, __m512i e, __m512i f, __m512i g, __m512i& h, __m512i k)
+{
+    __m512i t1 = Add(h, Sigma1(e), Ch(e, f, g), k);
+    __m512i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** Word i of the message schedule, computed in place for rounds 16 and above. */
+__m512i inline Schedule(__m512i* w, int i) {
+    if (i < 16) return w[i];
+    return Inc(w[i & 15], sigma1(w[(i - 2) & 15]), w[(i - 7) & 15], sigma0(w[(i - 15) & 15]));
+}
+
+/** Add one compressed 64-byte message block w to the state. */
+void inline Compress(__m512i* state, __m512i* w)
+{
+    __m512i a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i += 8) {
+        Round(a, b, c, d, e, f, g, h, Add(K(KS[i + 0]), Schedule(w, i + 0)));
+        Round(h, a, b, c, d, e, f, g, Add(K(KS[i + 1]), Schedule(w, i + 1)));
+        Round(g, h, a, b, c, d, e, f, Add(K(KS[i + 2]), Schedule(w, i + 2)));
+        Round(f, g, h, a, b, c, d, e, Add(K(KS[i + 3]), Schedule(w, i + 3)));
+        Round(e, f, g, h, a, b, c, d, Add(K(KS[i + 4]), Schedule(w, i + 4)));
+        Round(d, e, f, g, h, a, b, c, Add(K(KS[i + 5]), Schedule(w, i + 5)));
+        Round(c, d, e, f, g, h, a, b, Add(K(KS[i + 6]), Schedule(w, i + 6)));
+        Round(b, c, d, e, f, g, h, a, Add(K(KS[i + 7]), Schedule(w, i + 7)));
+    }
+
+    state[0] = Add(state[0], a);
+    state[1] = Add(state[1], b);
+    state[2] = Add(state[2], c);
+    state[3] = Add(state[3], d);
+    state[4] = Add(state[4], e);
+    state[5] = Add(state[5], f);
+    state[6] = Add(state[6], g);
+    state[7] = Add(state[7], h);
+}
+
+/** Read a big endian word at the given offset of every lane. */
+__m512i inline ReadLanes(const unsigned char* const chunks[16], size_t offset) {
+    return _mm512_set_epi32(
+        ReadBE32(chunks[15] + offset), ReadBE32(chunks[14] + offset), ReadBE32(chunks[13] + offset), ReadBE32(chunks[12] + offset),
+        ReadBE32(chunks[11] + offset), ReadBE32(chunks[10] + offset), ReadBE32(chunks[9] + offset), ReadBE32(chunks[8] + offset),
+        ReadBE32(chunks[7] + offset), ReadBE32(chunks[6] + offset), ReadBE32(chunks[5] + offset), ReadBE32(chunks[4] + offset),
+        ReadBE32(chunks[3] + offset), ReadBE32(chunks[2] + offset), ReadBE32(chunks[1] + offset), ReadBE32(chunks[0] + offset)
+    );
+}
+
+void inline StoreLanes(uint32_t lanes[16], __m512i v) {
+    _mm512_storeu_si512(reinterpret_cast<void*>(lanes), v);
+}
+
+}
+
+namespace sha256_avx512 {
+
+/** Perform a number of SHA-256 transformations on 16 independent streams.
+ *  s:      16 lanes of 8-word states, the state of lane i starts at s + 8 * i
+ *  chunks: pointers to the first 64-byte chunk of every lane
+ *  blocks: number of consecutive chunks to process in every lane
+ */
+void Transform_16way(uint32_t* s, const unsigned char* const chunks[16], size_t blocks)
+{
+    __m512i state[8];
+    for (int j = 0; j < 8; ++j) {
+        state[j] = _mm512_set_epi32(s[120 + j], s[112 + j], s[104 + j], s[96 + j], s[88 + j], s[80 + j], s[72 + j], s[64 + j],
+            s[56 + j], s[48 + j], s[40 + j], s[32 + j], s[24 + j], s[16 + j], s[8 + j], s[j]);
+    }
+
+    const unsigned char* in[16];
+    for (int i = 0; i < 16; ++i) in[i] = chunks[i];
+
+    while (blocks--) {
+        __m512i w[16];
+        for (int i = 0; i < 16; ++i) w[i] = ReadLanes(in, 4 * i);
+        Compress(state, w);
+        for (int i = 0; i < 16; ++i) in[i] += 64;
+    }
+
+    for (int j = 0; j < 8; ++j) {
+        uint32_t lanes[16];
+        StoreLanes(lanes, state[j]);
+        for (int i = 0; i < 16; ++i) s[8 * i + j] = lanes[i];
+    }
+}
+
+}
+
+namespace sha256d64_avx512 {
+
+/** Compute 16 double-SHA256's of consecutive 64-byte blobs. */
+void Transform_16way(unsigned char* out, const unsigned char* in)
+{
+    const unsigned char* chunks[16];
+    for (int i = 0; i < 16; ++i) chunks[i] = in + 64 * i;
+
+    // Transform 1: the 64-byte message
+    __m512i state[8];
+    for (int j = 0; j < 8; ++j) state[j] = K(INIT[j]);
+    __m512i w[16];
+    for (int i = 0; i < 16; ++i) w[i] = ReadLanes(chunks, 4 * i);
+    Compress(state, w);
+
+    // Transform 2: padding of the 64-byte message
+    w[0] = K(0x80000000ul);
+    for (int i = 1; i < 15; ++i) w[i] = K(0);
+    w[15] = K(0x200ul);
+    Compress(state, w);
+
+    // Transform 3: the 32-byte hash with its padding
+    for (int i = 0; i < 8; ++i) w[i] = state[i];
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; ++i) w[i] = K(0);
+    w[15] = K(0x100ul);
+    for (int j = 0; j < 8; ++j) state[j] = K(INIT[j]);
+    Compress(state, w);
+
+    // Output
+    for (int j = 0; j < 8; ++j) {
+        uint32_t lanes[16];
+        StoreLanes(lanes, state[j]);
+        for (int i = 0; i < 16; ++i) WriteBE32(out + 32 * i + 4 * j, lanes[i]);
+    }
+}
+
+}
+
+#endif
@@ -7,15 +7,21 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
+
+#include <sha256.h>
 
 /** A hasher class for SHA-512. */
 class CSHA512
 {
-private:
+protected:
     uint64_t s[8];
     unsigned char buf[128];
     uint64_t bytes;
 
+    /** Start from a custom initial state, used by the truncated variants. */
+    explicit CSHA512(const uint64_t init[8]);
+
 public:
     static constexpr size_t OUTPUT_SIZE = 64;
 
@@ -26,4 +32,41 @@ public:
     uint64_t Size() const { return bytes; }
 };
 
+/** A hasher class for SHA-512/256, SHA-512 with its own initial state truncated to 256 bits. */
+class CSHA512_256 : private CSHA512
+{
+public:
+    static constexpr size_t OUTPUT_SIZE = 32;
+
+    CSHA512_256();
+    CSHA512_256& Write(const unsigned char* data, size_t len) { CSHA512::Write(data, len); return *this; }
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+    CSHA512_256& Reset();
+    using CSHA512::Size;
+};
+
+/** Autodetect the best available SHA512 multi-stream implementation.
+ *  Only the implementations allowed by use_implementation are considered.
+ *  Returns the name of the implementation.
+ */
+std::string SHA512AutoDetect(sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL);
+
+/** Compute SHA512 hashes of multiple independent messages of equal length.
+ *  Messages are hashed in parallel lanes when a multi-stream implementation
+ *  is available, see SHA512MultiLanes.
+ *  outputs: pointers to count 64-byte output buffers
+ *  inputs:  pointers to count len-byte messages
+ *  count:   the number of messages
+ *  len:     the length of every message
+ */
+void SHA512Multi(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len);
+
+/** Compute SHA512/256 hashes of multiple independent messages of equal length, see SHA512Multi.
+ *  outputs: pointers to count 32-byte output buffers
+ */
+void SHA512_256Multi(unsigned char* const outputs[], const unsigned char* const inputs[], size_t count, size_t len);
+
+/** Returns the number of messages SHA512Multi hashes at once, 1 if no multi-stream implementation is available. */
+size_t SHA512MultiLanes();
+
 #endif // BITCOIN_CRYPTO_SHA512_H
@@ -0,0 +1,147 @@
+// 4-lane AVX2 SHA-512 kernel for multi-buffer hashing.
+// The rounds follow the 8-way AVX2 SHA-256 kernels of sha256_avx2.cpp, which come
+// from Bitcoin Core (Copyright (c) 2017-2019 The Bitcoin Core developers) and are
+// distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <common.h>
+
+namespace sha512_avx2 {
+namespace {
+
+const uint64_t KS[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+__m256i inline K(uint64_t x) { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z) { return Add(Add(x, y), z); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+__m256i inline Inc(__m256i& x, __m256i y, __m256i z, __m256i w) { x = Add(x, y, z, w); return x; }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline ShR(__m256i x, int n) { return _mm256_srli_epi64(x, n); }
+__m256i inline ShL(__m256i x, int n) { return _mm256_slli_epi64(x, n); }
+__m256i inline RotR(__m256i x, int n) { return Or(ShR(x, n), ShL(x, 64 - n)); }
+
+__m256i inline Ch(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+__m256i inline Maj(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m256i inline Sigma0(__m256i x) { return Xor(RotR(x, 28), RotR(x, 34), RotR(x, 39)); }
+__m256i inline Sigma1(__m256i x) { return Xor(RotR(x, 14), RotR(x, 18), RotR(x, 41)); }
+__m256i inline sigma0(__m256i x) { return Xor(RotR(x, 1), RotR(x, 8), ShR(x, 7)); }
+__m256i inline sigma1(__m256i x) { return Xor(RotR(x, 19), RotR(x, 61), ShR(x, 6)); }
+
+/** One round of SHA-512. */
+void ALWAYS_INLINE Round(__m256i a, __m256i b, __m256i c, __m256i& d, __m256i e, __m256i f, __m256i g, __m256i& h, __m256i k)
+{
+    __m256i t1 = Add(h, Sigma1(e), Ch(e, f, g), k);
+    __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** Read four consecutive big endian words at the given offset of every lane, transposed to one word per vector. */
+void inline ReadLanes(__m256i* w, const unsigned char* const chunks[4], size_t offset) {
+    const __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunks[0] + offset));
+    const __m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunks[1] + offset));
+    const __m256i r2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunks[2] + offset));
+    const __m256i r3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunks[3] + offset));
+    const __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    const __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    const __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    const __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    const __m256i bswap = _mm256_set_epi64x(0x08090A0B0C0D0E0FLL, 0x0001020304050607LL, 0x08090A0B0C0D0E0FLL, 0x0001020304050607LL);
+    w[0] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t0, t2, 0x20), bswap);
+    w[1] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t1, t3, 0x20), bswap);
+    w[2] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t0, t2, 0x31), bswap);
+    w[3] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(t1, t3, 0x31), bswap);
+}
+
+/** Word i of the message schedule, computed in place for rounds 16 and above. */
+__m256i inline Schedule(__m256i* w, int i) {
+    if (i < 16) return w[i];
+    return Inc(w[i & 15], sigma1(w[(i - 2) & 15]), w[(i - 7) & 15], sigma0(w[(i - 15) & 15]));
+}
+
+}
+
+/** Perform a number of SHA-512 transformations on 4 independent streams.
+ *  s:      4 lanes of 8-word states, the state of lane i starts at s + 8 * i
+ *  chunks: pointers to the first 128-byte chunk of every lane
+ *  blocks: number of consecutive chunks to process in every lane
+ */
+void Transform_4way(uint64_t* s, const unsigned char* const chunks[4], size_t blocks)
+{
+    __m256i state[8];
+    for (int j = 0; j < 8; ++j) {
+        state[j] = _mm256_set_epi64x(s[24 + j], s[16 + j], s[8 + j], s[j]);
+    }
+
+    const unsigned char* in[4];
+    for (int i = 0; i < 4; ++i) in[i] = chunks[i];
+
+    while (blocks--) {
+        __m256i a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+        __m256i w[16];
+        for (int i = 0; i < 16; i += 4) ReadLanes(w + i, in, 8 * i);
+
+        for (int i = 0; i < 80; i += 8) {
+            Round(a, b, c, d, e, f, g, h, Add(K(KS[i + 0]), Schedule(w, i + 0)));
+            Round(h, a, b, c, d, e, f, g, Add(K(KS[i + 1]), Schedule(w, i + 1)));
+            Round(g, h, a, b, c, d, e, f, Add(K(KS[i + 2]), Schedule(w, i + 2)));
+            Round(f, g, h, a, b, c, d, e, Add(K(KS[i + 3]), Schedule(w, i + 3)));
+            Round(e, f, g, h, a, b, c, d, Add(K(KS[i + 4]), Schedule(w, i + 4)));
+            Round(d, e, f, g, h, a, b, c, Add(K(KS[i + 5]), Schedule(w, i + 5)));
+            Round(c, d, e, f, g, h, a, b, Add(K(KS[i + 6]), Schedule(w, i + 6)));
+            Round(b, c, d, e, f, g, h, a, Add(K(KS[i + 7]), Schedule(w, i + 7)));
+        }
+
+        state[0] = Add(state[0], a);
+        state[1] = Add(state[1], b);
+        state[2] = Add(state[2], c);
+        state[3] = Add(state[3], d);
+        state[4] = Add(state[4], e);
+        state[5] = Add(state[5], f);
+        state[6] = Add(state[6], g);
+        state[7] = Add(state[7], h);
+
+        for (int i = 0; i < 4; ++i) in[i] += 128;
+    }
+
+    for (int j = 0; j < 8; ++j) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), state[j]);
+        for (int i = 0; i < 4; ++i) s[8 * i + j] = lanes[i];
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,430 @@
+// Implementation of the xxHash non-cryptographic hash algorithms,
+// compatible with the reference implementation https://github.com/Cyan4973/xxHash
+// xxHash algorithms are distributed under the BSD 2-Clause License.
+
+#include "xxhash.h"
+
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define XXH3_SSE2
+#endif
+
+namespace
+{
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+// Input is read in little endian order, which is the native order of the supported platforms
+inline uint64_t Read64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t RotL64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = RotL64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= Round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+inline uint64_t Avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+} // namespace
+
+XXH64_hash_t XXH64(const void* input, size_t length, XXH64_hash_t seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(input);
+    const unsigned char* const end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        // Four independent accumulators consume 32-byte stripes
+        const unsigned char* const limit = end - 32;
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = RotL64(v1, 1) + RotL64(v2, 7) + RotL64(v3, 12) + RotL64(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    }
+    else {
+        h = seed + PRIME64_5;
+    }
+
+    h += static_cast<uint64_t>(length);
+
+    while (end - p >= 8) {
+        h ^= Round(0, Read64(p));
+        h = RotL64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h ^= static_cast<uint64_t>(Read32(p)) * PRIME64_1;
+        h = RotL64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME64_5;
+        h = RotL64(h, 11) * PRIME64_1;
+        ++p;
+    }
+
+    return Avalanche(h);
+}
+
+void XXH64_canonicalFromHash(unsigned char dst[8], XXH64_hash_t hash)
+{
+    for (int i = 0; i < 8; ++i) {
+        dst[i] = static_cast<unsigned char>(hash >> (56 - 8 * i));
+    }
+}
+
+namespace
+{
+const uint32_t PRIME32_1 = 0x9E3779B1U;
+const uint32_t PRIME32_2 = 0x85EBCA77U;
+const uint32_t PRIME32_3 = 0xC2B2AE3DU;
+const uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+const uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+const size_t STRIPE_LEN = 64;
+const size_t ACC_NB = STRIPE_LEN / sizeof(uint64_t);
+const size_t SECRET_CONSUME_RATE = 8;
+const size_t SECRET_SIZE = 192;
+const size_t SECRET_SIZE_MIN = 136;
+const size_t SECRET_MERGEACCS_START = 11;
+const size_t SECRET_LASTACC_START = 7;
+const size_t MIDSIZE_STARTOFFSET = 3;
+const size_t MIDSIZE_LASTOFFSET = 17;
+const size_t MIDSIZE_MAX = 240;
+
+// Default secret of XXH3, which is also used when hashing without a custom secret
+alignas(64) const unsigned char kSecret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint32_t Swap32(uint32_t x)
+{
+    return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) | ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+inline uint64_t Swap64(uint64_t x)
+{
+    return (static_cast<uint64_t>(Swap32(static_cast<uint32_t>(x))) << 32) | Swap32(static_cast<uint32_t>(x >> 32));
+}
+
+inline uint32_t RotL32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+inline XXH128_hash_t Mult64to128(uint64_t a, uint64_t b)
+{
+    XXH128_hash_t r;
+#if defined(_MSC_VER) && defined(_M_X64)
+    r.low64 = _umul128(a, b, &r.high64);
+#else
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    r.low64 = static_cast<uint64_t>(product);
+    r.high64 = static_cast<uint64_t>(product >> 64);
+#endif
+    return r;
+}
+
+inline uint64_t Mul128Fold64(uint64_t a, uint64_t b)
+{
+    const XXH128_hash_t product = Mult64to128(a, b);
+    return product.low64 ^ product.high64;
+}
+
+inline uint64_t XorShift64(uint64_t v, int shift)
+{
+    return v ^ (v >> shift);
+}
+
+inline uint64_t Avalanche3(uint64_t h)
+{
+    h = XorShift64(h, 37);
+    h *= PRIME_MX1;
+    return XorShift64(h, 32);
+}
+
+inline uint64_t Mix16B(const unsigned char* input, const unsigned char* secret)
+{
+    return Mul128Fold64(Read64(input) ^ Read64(secret), Read64(input + 8) ^ Read64(secret + 8));
+}
+
+inline void Mix32B(XXH128_hash_t& acc, const unsigned char* input1, const unsigned char* input2, const unsigned char* secret)
+{
+    acc.low64 += Mix16B(input1, secret);
+    acc.low64 ^= Read64(input2) + Read64(input2 + 8);
+    acc.high64 += Mix16B(input2, secret + 16);
+    acc.high64 ^= Read64(input1) + Read64(input1 + 8);
+}
+
+XXH128_hash_t Len1to3(const unsigned char* input, size_t length)
+{
+    const uint32_t c1 = input[0];
+    const uint32_t c2 = input[length >> 1];
+    const uint32_t c3 = input[length - 1];
+    const uint32_t combinedl = (c1 << 16) | (c2 << 24) | c3 | (static_cast<uint32_t>(length) << 8);
+    const uint32_t combinedh = RotL32(Swap32(combinedl), 13);
+    const uint64_t bitflipl = Read32(kSecret) ^ Read32(kSecret + 4);
+    const uint64_t bitfliph = Read32(kSecret + 8) ^ Read32(kSecret + 12);
+    XXH128_hash_t h;
+    h.low64 = Avalanche(combinedl ^ bitflipl);
+    h.high64 = Avalanche(combinedh ^ bitfliph);
+    return h;
+}
+
+XXH128_hash_t Len4to8(const unsigned char* input, size_t length)
+{
+    const uint64_t input64 = Read32(input) + (static_cast<uint64_t>(Read32(input + length - 4)) << 32);
+    const uint64_t bitflip = Read64(kSecret + 16) ^ Read64(kSecret + 24);
+    XXH128_hash_t m = Mult64to128(input64 ^ bitflip, PRIME64_1 + (length << 2));
+    m.high64 += m.low64 << 1;
+    m.low64 ^= m.high64 >> 3;
+    m.low64 = XorShift64(m.low64, 35);
+    m.low64 *= PRIME_MX2;
+    m.low64 = XorShift64(m.low64, 28);
+    m.high64 = Avalanche3(m.high64);
+    return m;
+}
+
+XXH128_hash_t Len9to16(const unsigned char* input, size_t length)
+{
+    const uint64_t bitflipl = Read64(kSecret + 32) ^ Read64(kSecret + 40);
+    const uint64_t bitfliph = Read64(kSecret + 48) ^ Read64(kSecret + 56);
+    const uint64_t inputLo = Read64(input);
+    const uint64_t inputHi = Read64(input + length - 8) ^ bitfliph;
+    XXH128_hash_t m = Mult64to128(inputLo ^ Read64(input + length - 8) ^ bitflipl, PRIME64_1);
+    m.low64 += static_cast<uint64_t>(length - 1) << 54;
+    m.high64 += inputHi + static_cast<uint64_t>(static_cast<uint32_t>(inputHi)) * (PRIME32_2 - 1);
+    m.low64 ^= Swap64(m.high64);
+    XXH128_hash_t h = Mult64to128(m.low64, PRIME64_2);
+    h.high64 += m.high64 * PRIME64_2;
+    h.low64 = Avalanche3(h.low64);
+    h.high64 = Avalanche3(h.high64);
+    return h;
+}
+
+XXH128_hash_t FinalizeMid(const XXH128_hash_t& acc, size_t length)
+{
+    XXH128_hash_t h;
+    h.low64 = Avalanche3(acc.low64 + acc.high64);
+    h.high64 = 0 - Avalanche3(acc.low64 * PRIME64_1 + acc.high64 * PRIME64_4 + length * PRIME64_2);
+    return h;
+}
+
+XXH128_hash_t Len17to128(const unsigned char* input, size_t length)
+{
+    XXH128_hash_t acc = { length * PRIME64_1, 0 };
+    if (length > 32) {
+        if (length > 64) {
+            if (length > 96) {
+                Mix32B(acc, input + 48, input + length - 64, kSecret + 96);
+            }
+            Mix32B(acc, input + 32, input + length - 48, kSecret + 64);
+        }
+        Mix32B(acc, input + 16, input + length - 32, kSecret + 32);
+    }
+    Mix32B(acc, input, input + length - 16, kSecret);
+    return FinalizeMid(acc, length);
+}
+
+XXH128_hash_t Len129to240(const unsigned char* input, size_t length)
+{
+    const size_t rounds = length / 32;
+    XXH128_hash_t acc = { length * PRIME64_1, 0 };
+    for (size_t i = 0; i < 4; ++i) {
+        Mix32B(acc, input + 32 * i, input + 32 * i + 16, kSecret + 32 * i);
+    }
+    acc.low64 = Avalanche3(acc.low64);
+    acc.high64 = Avalanche3(acc.high64);
+    for (size_t i = 4; i < rounds; ++i) {
+        Mix32B(acc, input + 32 * i, input + 32 * i + 16, kSecret + MIDSIZE_STARTOFFSET + 32 * (i - 4));
+    }
+    Mix32B(acc, input + length - 16, input + length - 32, kSecret + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET - 16);
+    return FinalizeMid(acc, length);
+}
+
+#if defined(XXH3_SSE2)
+// Each 128-bit vector holds two of the eight accumulators
+inline void Accumulate512(uint64_t* acc, const unsigned char* input, const unsigned char* secret)
+{
+    __m128i* const xacc = reinterpret_cast<__m128i*>(acc);
+    for (size_t i = 0; i < ACC_NB / 2; ++i) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input) + i);
+        const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i);
+        const __m128i dataKey = _mm_xor_si128(data, key);
+        const __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+        const __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+        const __m128i dataSwap = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], dataSwap));
+    }
+}
+
+inline void ScrambleAcc(uint64_t* acc, const unsigned char* secret)
+{
+    __m128i* const xacc = reinterpret_cast<__m128i*>(acc);
+    const __m128i prime32 = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+    for (size_t i = 0; i < ACC_NB / 2; ++i) {
+        const __m128i a = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+        const __m128i dataKey = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+        const __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+        const __m128i productLo = _mm_mul_epu32(dataKey, prime32);
+        const __m128i productHi = _mm_mul_epu32(dataKeyHi, prime32);
+        xacc[i] = _mm_add_epi64(productLo, _mm_slli_epi64(productHi, 32));
+    }
+}
+#else
+inline void Accumulate512(uint64_t* acc, const unsigned char* input, const unsigned char* secret)
+{
+    for (size_t i = 0; i < ACC_NB; ++i) {
+        const uint64_t data = Read64(input + 8 * i);
+        const uint64_t dataKey = data ^ Read64(secret + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+    }
+}
+
+inline void ScrambleAcc(uint64_t* acc, const unsigned char* secret)
+{
+    for (size_t i = 0; i < ACC_NB; ++i) {
+        uint64_t a = XorShift64(acc[i], 47);
+        a ^= Read64(secret + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+#endif
+
+inline void Accumulate(uint64_t* acc, const unsigned char* input, const unsigned char* secret, size_t stripes)
+{
+    for (size_t n = 0; n < stripes; ++n) {
+        Accumulate512(acc, input + n * STRIPE_LEN, secret + n * SECRET_CONSUME_RATE);
+    }
+}
+
+uint64_t MergeAccs(const uint64_t* acc, const unsigned char* secret, uint64_t start)
+{
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; ++i) {
+        result += Mul128Fold64(acc[2 * i] ^ Read64(secret + 16 * i), acc[2 * i + 1] ^ Read64(secret + 16 * i + 8));
+    }
+    return Avalanche3(result);
+}
+
+XXH128_hash_t HashLong(const unsigned char* input, size_t length)
+{
+    alignas(16) uint64_t acc[ACC_NB] = { PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 };
+    const size_t stripesPerBlock = (SECRET_SIZE - STRIPE_LEN) / SECRET_CONSUME_RATE;
+    const size_t blockLen = STRIPE_LEN * stripesPerBlock;
+    const size_t blocks = (length - 1) / blockLen;
+
+    for (size_t n = 0; n < blocks; ++n) {
+        Accumulate(acc, input + n * blockLen, kSecret, stripesPerBlock);
+        ScrambleAcc(acc, kSecret + SECRET_SIZE - STRIPE_LEN);
+    }
+
+    // The last partial block and the last stripe, which may overlap with it
+    const size_t stripes = ((length - 1) - blockLen * blocks) / STRIPE_LEN;
+    Accumulate(acc, input + blocks * blockLen, kSecret, stripes);
+    Accumulate512(acc, input + length - STRIPE_LEN, kSecret + SECRET_SIZE - STRIPE_LEN - SECRET_LASTACC_START);
+
+    XXH128_hash_t h;
+    h.low64 = MergeAccs(acc, kSecret + SECRET_MERGEACCS_START, length * PRIME64_1);
+    h.high64 = MergeAccs(acc, kSecret + SECRET_SIZE - sizeof(acc) - SECRET_MERGEACCS_START, ~(length * PRIME64_2));
+    return h;
+}
+} // namespace
+
+XXH128_hash_t XXH3_128bits(const void* input, size_t length)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(input);
+
+    if (length <= 16) {
+        if (length > 8) {
+            return Len9to16(p, length);
+        }
+        if (length >= 4) {
+            return Len4to8(p, length);
+        }
+        if (length) {
+            return Len1to3(p, length);
+        }
+        XXH128_hash_t h;
+        h.low64 = Avalanche(Read64(kSecret + 64) ^ Read64(kSecret + 72));
+        h.high64 = Avalanche(Read64(kSecret + 80) ^ Read64(kSecret + 88));
+        return h;
+    }
+    if (length <= 128) {
+        return Len17to128(p, length);
+    }
+    if (length <= MIDSIZE_MAX) {
+        return Len129to240(p, length);
+    }
+    return HashLong(p, length);
+}
+
+void XXH128_canonicalFromHash(unsigned char dst[16], XXH128_hash_t hash)
+{
+    XXH64_canonicalFromHash(dst, hash.high64);
+    XXH64_canonicalFromHash(dst + 8, hash.low64);
+}
@@ -0,0 +1,30 @@
+// Implementation of the xxHash non-cryptographic hash algorithms,
+// compatible with the reference implementation https://github.com/Cyan4973/xxHash
+// xxHash algorithms are distributed under the BSD 2-Clause License.
+
+#ifndef XXHASH_H
+#define XXHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint64_t XXH64_hash_t;
+
+/** Computes the 64-bit xxHash of the input with the given seed. */
+XXH64_hash_t XXH64(const void* input, size_t length, XXH64_hash_t seed);
+
+/** Writes the hash in the canonical big endian representation. */
+void XXH64_canonicalFromHash(unsigned char dst[8], XXH64_hash_t hash);
+
+typedef struct {
+    uint64_t low64;
+    uint64_t high64;
+} XXH128_hash_t;
+
+/** Computes the 128-bit XXH3 hash of the input with the default secret and seed. */
+XXH128_hash_t XXH3_128bits(const void* input, size_t length);
+
+/** Writes the hash in the canonical big endian representation, high half first. */
+void XXH128_canonicalFromHash(unsigned char dst[16], XXH128_hash_t hash);
+
+#endif // XXHASH_H
@@ -0,0 +1,276 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "SignatureGenerator.h"
+#include "TestFiles.h"
+
+namespace {
+
+const uint64_t BLOCK_SIZE = 64 * KB;
+const uint64_t BLOCKS = 48;
+const uint64_t CHECKPOINT_BLOCKS = 30;  // Blocks the checkpoint of the interrupted run refers to
+const uint64_t WRITTEN_BLOCKS = 41;     // Blocks written by the interrupted run after its checkpoint
+
+// Settings of a signature layout and the sizes the generator writes for them
+struct Layout
+{
+    const char* name;
+    HashSettings hashing;
+    OutputSettings output;
+    uint64_t headerSize;
+    uint8_t recordSize;
+    uint8_t flags;
+};
+
+std::vector<Layout> Layouts()
+{
+    std::vector<Layout> layouts;
+
+    Layout plain = { "sha256" };
+    plain.headerSize = SignatureHeader::RECORDS_ALIGNMENT;
+    plain.recordSize = 32;
+    plain.flags = 0;
+    layouts.push_back(plain);
+
+    Layout merkle = plain;
+    merkle.name = "sha256 with Merkle tree";
+    merkle.output.merkleTree = true;
+    merkle.flags = SignatureHeader::FLAG_MERKLE_TREE;
+    layouts.push_back(merkle);
+
+    Layout weak = { "raw xxh3 with weak checksums" };
+    weak.hashing.algorithm = HashAlgorithm::XXH3_128;
+    weak.hashing.weakChecksum = true;
+    weak.output.raw = true;
+    weak.headerSize = SignatureHeader::SIZE_V1;
+    weak.recordSize = 16 + WeakChecksum::SIZE;
+    weak.flags = SignatureHeader::FLAG_WEAK_CHECKSUM;
+    layouts.push_back(weak);
+
+    Layout raw = { "raw sha256" };
+    raw.output.raw = true;
+    raw.headerSize = 0;
+    raw.recordSize = 32;
+    raw.flags = 0;
+    layouts.push_back(raw);
+    return layouts;
+}
+
+std::vector<unsigned char> MakeInput(const std::string& path)
+{
+    // Last block is partial, so it is complemented with zeroes in the resumed run as well
+    auto data = RandomData(static_cast<size_t>(BLOCKS * BLOCK_SIZE - 1000), 21);
+    WriteTestFile(path, data);
+    return data;
+}
+
+void Generate(const std::string& inputPath, const std::string& outputPath, const Layout& layout, ReadMode mode, bool resume)
+{
+    ReaderSettings reader;
+    reader.mode = mode;
+    OutputSettings output = layout.output;
+    output.resume = resume;
+    SignatureGenerator generator(inputPath, outputPath, BLOCK_SIZE, reader, layout.hashing, output);
+    generator.Generate();
+}
+
+SignatureCheckpoint MakeCheckpoint(const std::string& inputPath, const Layout& layout, uint64_t blocks)
+{
+    SignatureCheckpoint checkpoint = { layout.hashing.algorithm, layout.recordSize, layout.flags, BLOCK_SIZE,
+        boost::filesystem::file_size(inputPath), static_cast<int64_t>(boost::filesystem::last_write_time(inputPath)), blocks };
+    return checkpoint;
+}
+
+void WriteCheckpoint(const std::string& outputPath, const SignatureCheckpoint& checkpoint)
+{
+    std::vector<unsigned char> serialized(SignatureCheckpoint::SIZE);
+    checkpoint.Serialize(serialized.data());
+    WriteTestFile(outputPath + ".checkpoint", serialized);
+}
+
+// Leaves the output file as a run interrupted after its checkpoint does. The hashes up to
+// the checkpoint are on the disk, the ones after it were being written, and the Merkle root
+// and the levels of the tree, which are written after the last block, are missing.
+void Interrupt(const std::vector<unsigned char>& complete, const std::string& inputPath, const std::string& outputPath, const Layout& layout)
+{
+    std::vector<unsigned char> interrupted(complete.begin(), complete.begin() + static_cast<size_t>(layout.headerSize + WRITTEN_BLOCKS * layout.recordSize));
+    std::fill(interrupted.begin() + static_cast<size_t>(layout.headerSize + CHECKPOINT_BLOCKS * layout.recordSize), interrupted.end(), 0xA5);
+    if (layout.output.merkleTree) {
+        std::fill(interrupted.begin() + SignatureHeader::SIZE, interrupted.begin() + SignatureHeader::SIZE + MerkleTree::NODE_SIZE, 0);
+    }
+    WriteTestFile(outputPath, interrupted);
+    WriteCheckpoint(outputPath, MakeCheckpoint(inputPath, layout, CHECKPOINT_BLOCKS));
+}
+
+bool HasErrorCode(SignatureGeneratorException exception, int error)
+{
+    return exception.ErrorCode() == error;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(CheckpointTests)
+
+BOOST_AUTO_TEST_CASE(ResumedSignatureEqualsUninterruptedOne)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    MakeInput(inputPath);
+
+    for (const auto& layout : Layouts()) {
+        for (ReadMode mode : { ReadMode::Stream, ReadMode::Mapped, ReadMode::Positional }) {
+            BOOST_TEST_CONTEXT(layout.name << ", read mode " << static_cast<int>(mode)) {
+                const std::string completePath = directory.File("complete.sig");
+                const std::string resumedPath = directory.File("resumed.sig");
+                Generate(inputPath, completePath, layout, mode, false);
+                const auto complete = ReadTestFile(completePath);
+                BOOST_REQUIRE(complete.size() >= layout.headerSize + BLOCKS * layout.recordSize);
+
+                Interrupt(complete, inputPath, resumedPath, layout);
+                Generate(inputPath, resumedPath, layout, mode, true);
+
+                BOOST_TEST(ReadTestFile(resumedPath) == complete, boost::test_tools::per_element());
+                BOOST_TEST(!boost::filesystem::exists(resumedPath + ".checkpoint"));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CompleteRunRemovesCheckpoint)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string outputPath = directory.File("output.sig");
+    MakeInput(inputPath);
+    const Layout layout = Layouts().front();
+
+    // Checkpoint of a previous generation does not survive a new one
+    WriteCheckpoint(outputPath, MakeCheckpoint(inputPath, layout, CHECKPOINT_BLOCKS));
+    Generate(inputPath, outputPath, layout, ReadMode::Stream, false);
+    BOOST_TEST(!boost::filesystem::exists(outputPath + ".checkpoint"));
+}
+
+BOOST_AUTO_TEST_CASE(FailedRunRemovesCheckpoint)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string completePath = directory.File("complete.sig");
+    const std::string resumedPath = directory.File("resumed.sig");
+    const Layout layout = Layouts().front();
+
+    for (ReadMode mode : { ReadMode::Stream, ReadMode::Positional, ReadMode::Async }) {
+        BOOST_TEST_CONTEXT("read mode " << static_cast<int>(mode)) {
+            MakeInput(inputPath);
+            Generate(inputPath, completePath, layout, mode, false);
+            Interrupt(ReadTestFile(completePath), inputPath, resumedPath, layout);
+            {
+                ReaderSettings reader;
+                reader.mode = mode;
+                OutputSettings output = layout.output;
+                output.resume = true;
+                SignatureGenerator generator(inputPath, resumedPath, BLOCK_SIZE, reader, layout.hashing, output);
+
+                // Blocks before the cut are checked and hashed, reading the ones after it fails
+                boost::filesystem::resize_file(inputPath, (WRITTEN_BLOCKS + 1) * BLOCK_SIZE);
+                BOOST_CHECK_EXCEPTION(generator.Generate(), SignatureGeneratorException,
+                    [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_READ_FAULT); });
+            }
+            BOOST_TEST(!boost::filesystem::exists(resumedPath + ".checkpoint"));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DamagedCheckpointIsRejected)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string completePath = directory.File("complete.sig");
+    const std::string resumedPath = directory.File("resumed.sig");
+    MakeInput(inputPath);
+    const Layout layout = Layouts().front();
+    Generate(inputPath, completePath, layout, ReadMode::Stream, false);
+    Interrupt(ReadTestFile(completePath), inputPath, resumedPath, layout);
+
+    // Every byte of the checkpoint is covered by its CRC
+    const auto valid = ReadTestFile(resumedPath + ".checkpoint");
+    for (size_t i = 0; i < valid.size(); ++i) {
+        BOOST_TEST_CONTEXT("byte " << i) {
+            auto damaged = valid;
+            damaged[i] ^= 0x10;
+            WriteTestFile(resumedPath + ".checkpoint", damaged);
+            BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+                [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_FILE_NOT_FOUND); });
+        }
+    }
+
+    // Truncated checkpoint, as one written partially, is rejected as well
+    WriteTestFile(resumedPath + ".checkpoint", std::vector<unsigned char>(valid.begin(), valid.end() - 1));
+    BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_FILE_NOT_FOUND); });
+    boost::filesystem::remove(resumedPath + ".checkpoint");
+    BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_FILE_NOT_FOUND); });
+}
+
+BOOST_AUTO_TEST_CASE(CheckpointOfOtherSettingsIsRejected)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string completePath = directory.File("complete.sig");
+    const std::string resumedPath = directory.File("resumed.sig");
+    MakeInput(inputPath);
+    const Layout layout = Layouts().front();
+    Generate(inputPath, completePath, layout, ReadMode::Stream, false);
+    const auto complete = ReadTestFile(completePath);
+
+    std::vector<SignatureCheckpoint> others;
+    for (int i = 0; i < 5; ++i) others.push_back(MakeCheckpoint(inputPath, layout, CHECKPOINT_BLOCKS));
+    others[0].algorithm = HashAlgorithm::Blake3;
+    others[1].blockSize = BLOCK_SIZE * 2;
+    others[2].inputSize += 1;
+    others[3].inputTime += 1;
+    others[4].blocks = BLOCKS + 1;
+    for (const auto& checkpoint : others) {
+        Interrupt(complete, inputPath, resumedPath, layout);
+        WriteCheckpoint(resumedPath, checkpoint);
+        BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+            [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(OutputNotMatchingCheckpointIsRejected)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string completePath = directory.File("complete.sig");
+    const std::string resumedPath = directory.File("resumed.sig");
+    MakeInput(inputPath);
+    const Layout layout = Layouts().front();
+    Generate(inputPath, completePath, layout, ReadMode::Stream, false);
+    const auto complete = ReadTestFile(completePath);
+
+    // Output file lost the hashes before the checkpoint
+    Interrupt(complete, inputPath, resumedPath, layout);
+    boost::filesystem::resize_file(resumedPath, layout.headerSize + (CHECKPOINT_BLOCKS - 1) * layout.recordSize);
+    BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+
+    // Header of the output file was made for other settings
+    Interrupt(complete, inputPath, resumedPath, layout);
+    auto interrupted = ReadTestFile(resumedPath);
+    interrupted[5] = static_cast<unsigned char>(HashAlgorithm::Blake3);
+    WriteTestFile(resumedPath, interrupted);
+    BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+
+    // One of the last hashes before the checkpoint, which are checked against the input file, is wrong
+    Interrupt(complete, inputPath, resumedPath, layout);
+    interrupted = ReadTestFile(resumedPath);
+    interrupted[static_cast<size_t>(layout.headerSize + (CHECKPOINT_BLOCKS - 2) * layout.recordSize)] ^= 1;
+    WriteTestFile(resumedPath, interrupted);
+    BOOST_CHECK_EXCEPTION(Generate(inputPath, resumedPath, layout, ReadMode::Stream, true), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
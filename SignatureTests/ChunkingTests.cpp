@@ -0,0 +1,227 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "SignatureGenerator.h"
+#include "TestFiles.h"
+
+namespace {
+
+// Chunk as written to the signature or as cut by a sequential pass
+struct Chunk
+{
+    uint64_t offset;
+    uint32_t length;
+    std::vector<unsigned char> hash;
+
+    bool operator==(const Chunk& other) const {
+        return offset == other.offset && length == other.length && hash == other.hash;
+    }
+};
+
+std::ostream& operator<<(std::ostream& out, const Chunk& chunk)
+{
+    return out << "chunk at " << chunk.offset << " of " << chunk.length << " bytes";
+}
+
+std::vector<unsigned char> Sha256(const unsigned char* data, size_t length)
+{
+    std::vector<unsigned char> hash(CSHA256::OUTPUT_SIZE);
+    CSHA256().Write(data, length).Finalize(hash.data());
+    return hash;
+}
+
+// Chunks of the whole data cut one after another from its start
+std::vector<Chunk> CutSequentially(const std::vector<unsigned char>& data, const ChunkingSettings& chunking)
+{
+    const GearChunker chunker(chunking.minSize, chunking.avgSize, chunking.maxSize);
+    std::vector<Chunk> chunks;
+    for (uint64_t offset = 0; offset < data.size();) {
+        const uint64_t end = chunker.Cut(data.data(), offset, data.size());
+        const uint32_t length = static_cast<uint32_t>(end - offset);
+        chunks.push_back({ offset, length, Sha256(data.data() + offset, length) });
+        offset = end;
+    }
+    return chunks;
+}
+
+// Chunks of the input file generated in parallel by segments of the given size
+std::vector<Chunk> Generate(const std::vector<unsigned char>& data, const ChunkingSettings& chunking, uint64_t segmentSize, bool raw)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string outputPath = directory.File("output.sig");
+    WriteTestFile(inputPath, data);
+
+    ReaderSettings reader;
+    reader.mode = ReadMode::Mapped;
+    OutputSettings output;
+    output.raw = raw;
+    SignatureGenerator generator(inputPath, outputPath, segmentSize, reader, HashSettings(), output,
+        VerifySettings(), UpdateSettings(), chunking);
+    generator.Generate();
+
+    const auto signature = ReadTestFile(outputPath);
+    SignatureHeader header;
+    BOOST_REQUIRE(header.Deserialize(signature.data(), signature.size()));
+    BOOST_REQUIRE(header.flags & SignatureHeader::FLAG_CHUNKS);
+    BOOST_REQUIRE(header.hashSize == CSHA256::OUTPUT_SIZE);
+    BOOST_REQUIRE(header.version == (raw ? +SignatureHeader::VERSION_1 : +SignatureHeader::VERSION));
+
+    // Chunk sizes follow the header fields
+    const unsigned char* parameters = signature.data() + header.FieldsSize();
+    BOOST_TEST(ReadLE32(parameters) == chunking.minSize);
+    BOOST_TEST(ReadLE32(parameters + 4) == chunking.avgSize);
+    BOOST_TEST(ReadLE32(parameters + 8) == chunking.maxSize);
+
+    const size_t recordSize = SignatureHeader::CHUNK_RECORD_PREFIX + header.hashSize;
+    const uint64_t recordsOffset = header.RecordsOffset();
+    BOOST_REQUIRE(signature.size() >= recordsOffset);
+    BOOST_REQUIRE_EQUAL((signature.size() - recordsOffset) % recordSize, 0u);
+    const uint64_t count = (signature.size() - recordsOffset) / recordSize;
+    if (!raw) BOOST_TEST(header.records == count);
+
+    std::vector<Chunk> chunks;
+    for (uint64_t i = 0; i < count; ++i) {
+        const unsigned char* record = signature.data() + recordsOffset + i * recordSize;
+        const unsigned char* hash = record + SignatureHeader::CHUNK_RECORD_PREFIX;
+        chunks.push_back({ ReadLE64(record), ReadLE32(record + 8), std::vector<unsigned char>(hash, hash + header.hashSize) });
+    }
+    return chunks;
+}
+
+// Checks that the chunks cover the data without gaps, have sizes within the bounds and hashes of their bytes
+void CheckChunks(const std::vector<Chunk>& chunks, const std::vector<unsigned char>& data, const ChunkingSettings& chunking)
+{
+    uint64_t position = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        BOOST_TEST_CONTEXT("chunk " << i << " of " << chunks.size()) {
+            const Chunk& chunk = chunks[i];
+            BOOST_REQUIRE_EQUAL(chunk.offset, position);
+            BOOST_REQUIRE(chunk.length > 0u);
+            BOOST_REQUIRE(chunk.offset + chunk.length <= data.size());
+            BOOST_TEST(chunk.length <= chunking.maxSize);
+            // Only the last chunk may be shorter than the minimum, it ends with the data
+            if (i + 1 < chunks.size()) BOOST_TEST(chunk.length >= chunking.minSize);
+            BOOST_TEST(chunk.hash == Sha256(data.data() + chunk.offset, chunk.length), boost::test_tools::per_element());
+            position += chunk.length;
+        }
+    }
+    BOOST_TEST(position == data.size());
+}
+
+ChunkingSettings Chunking(uint32_t minSize, uint32_t avgSize, uint32_t maxSize)
+{
+    ChunkingSettings chunking;
+    chunking.enabled = true;
+    chunking.minSize = minSize;
+    chunking.avgSize = avgSize;
+    chunking.maxSize = maxSize;
+    return chunking;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ChunkingTests)
+
+BOOST_AUTO_TEST_CASE(ParallelSegmentsGiveSequentialCutPoints)
+{
+    const ChunkingSettings settings[] = {
+        Chunking(2 * KB, 8 * KB, 64 * KB),
+        Chunking(256, 1 * KB, 4 * KB),
+        Chunking(4 * KB, 8 * KB, 12 * KB),
+        Chunking(63, 64, 65),
+    };
+    const auto data = RandomData(3 * MB + 777, 22);
+
+    for (const auto& chunking : settings) {
+        const auto expected = CutSequentially(data, chunking);
+        CheckChunks(expected, data, chunking);
+
+        // Smallest segments allowed and larger ones, both in the header versions
+        for (uint64_t segmentSize : { 2ULL * chunking.maxSize, 2ULL * chunking.maxSize + 1, 256ULL * KB }) {
+            for (bool raw : { false, true }) {
+                BOOST_TEST_CONTEXT("chunks " << chunking.minSize << "/" << chunking.avgSize << "/" << chunking.maxSize
+                    << ", segment " << segmentSize << (raw ? ", raw" : "")) {
+                    BOOST_REQUIRE(data.size() / segmentSize >= 4);
+                    const auto chunks = Generate(data, chunking, segmentSize, raw);
+                    CheckChunks(chunks, data, chunking);
+                    BOOST_TEST(chunks == expected, boost::test_tools::per_element());
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AverageSizeIsNearTheExpectedOne)
+{
+    const auto data = RandomData(4 * MB, 23);
+    for (const auto& chunking : { Chunking(2 * KB, 8 * KB, 64 * KB), Chunking(1 * KB, 4 * KB, 16 * KB) }) {
+        BOOST_TEST_CONTEXT("chunks " << chunking.minSize << "/" << chunking.avgSize << "/" << chunking.maxSize) {
+            const auto chunks = Generate(data, chunking, 4ULL * chunking.maxSize, false);
+            CheckChunks(chunks, data, chunking);
+            // Normalized chunking keeps the average of random data close to the requested one
+            const double average = static_cast<double>(data.size()) / chunks.size();
+            BOOST_TEST(average >= chunking.avgSize * 0.75);
+            BOOST_TEST(average <= chunking.avgSize * 1.5);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EdgeCases)
+{
+    const ChunkingSettings chunking = Chunking(2 * KB, 8 * KB, 64 * KB);
+    // Segments are not a multiple of the maximum chunk size
+    const uint64_t segmentSize = 2ULL * chunking.maxSize + 1;
+
+    std::vector<std::vector<unsigned char>> inputs;
+    inputs.push_back(RandomData(1, 24));                                             // Shorter than the minimum chunk
+    inputs.push_back(RandomData(chunking.minSize, 24));                              // Exactly the minimum chunk
+    inputs.push_back(RandomData(chunking.minSize + 1, 24));                          // Last chunk of one byte at most
+    inputs.push_back(RandomData(static_cast<size_t>(segmentSize), 24));              // One full segment
+    inputs.push_back(RandomData(static_cast<size_t>(5 * segmentSize), 24));          // Input ends at a segment end
+    inputs.push_back(RandomData(static_cast<size_t>(5 * segmentSize + 1), 24));      // Last segment of one byte
+    // Data without boundaries is cut by the maximum size, so its chunks start inside the segments
+    inputs.push_back(std::vector<unsigned char>(static_cast<size_t>(7 * segmentSize + 12345), 0));
+    // Boundaries of the repeated pattern are at the same places of every repetition
+    std::vector<unsigned char> repeated;
+    const auto pattern = RandomData(static_cast<size_t>(segmentSize / 3 + 17), 25);
+    for (int i = 0; i < 20; ++i) repeated.insert(repeated.end(), pattern.begin(), pattern.end());
+    inputs.push_back(repeated);
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        BOOST_TEST_CONTEXT("input " << i << " of " << inputs[i].size() << " bytes") {
+            const auto chunks = Generate(inputs[i], chunking, segmentSize, false);
+            CheckChunks(chunks, inputs[i], chunking);
+            BOOST_TEST(chunks == CutSequentially(inputs[i], chunking), boost::test_tools::per_element());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidSettingsAreRejected)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    WriteTestFile(inputPath, RandomData(1 * MB, 26));
+
+    ReaderSettings mapped;
+    mapped.mode = ReadMode::Mapped;
+    const ChunkingSettings valid = Chunking(2 * KB, 8 * KB, 64 * KB);
+    const ChunkingSettings invalid[] = {
+        Chunking(0, 8 * KB, 64 * KB),
+        Chunking(8 * KB, 8 * KB, 64 * KB),
+        Chunking(2 * KB, 64 * KB, 64 * KB),
+        Chunking(2 * KB, 6 * KB, 64 * KB),
+    };
+    for (const auto& chunking : invalid) {
+        BOOST_CHECK_THROW(SignatureGenerator(inputPath, directory.File("output.sig"), 256 * KB, mapped, HashSettings(),
+            OutputSettings(), VerifySettings(), UpdateSettings(), chunking), SignatureGeneratorException);
+    }
+    // Segments shorter than two maximum chunks
+    BOOST_CHECK_THROW(SignatureGenerator(inputPath, directory.File("output.sig"), 2ULL * valid.maxSize - 1, mapped, HashSettings(),
+        OutputSettings(), VerifySettings(), UpdateSettings(), valid), SignatureGeneratorException);
+    // Chunks are cut only from the mapped input
+    BOOST_CHECK_THROW(SignatureGenerator(inputPath, directory.File("output.sig"), 256 * KB, ReaderSettings(), HashSettings(),
+        OutputSettings(), VerifySettings(), UpdateSettings(), valid), SignatureGeneratorException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
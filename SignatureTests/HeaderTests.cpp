@@ -0,0 +1,80 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "SignatureGenerator.h"
+#include "TestFiles.h"
+
+namespace {
+
+const uint64_t BLOCK_SIZE = 64 * KB;
+const uint64_t BLOCKS = 20;
+
+bool HasErrorCode(SignatureGeneratorException exception, int error)
+{
+    return exception.ErrorCode() == error;
+}
+
+// Generates the signature of the input file with weak checksums, so it can be searched for as well
+void GenerateSignature(const std::string& inputPath, const std::string& signaturePath, uint64_t blockSize, bool raw)
+{
+    HashSettings hashing;
+    hashing.weakChecksum = true;
+    OutputSettings output;
+    output.raw = raw;
+    SignatureGenerator(inputPath, signaturePath, blockSize, ReaderSettings(), hashing, output).Generate();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(HeaderTests)
+
+BOOST_AUTO_TEST_CASE(BlockSizeIsTakenFromHeader)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string signaturePath = directory.File("signature.sig");
+    WriteTestFile(inputPath, RandomData(static_cast<size_t>(BLOCKS * BLOCK_SIZE + 100), 60));
+    GenerateSignature(inputPath, signaturePath, BLOCK_SIZE, false);
+
+    VerifySettings verify;
+    verify.enabled = true;
+    SignatureGenerator verifier(inputPath, signaturePath, 0, ReaderSettings(), HashSettings(), OutputSettings(), verify);
+    BOOST_TEST(verifier.GetBlockSize() == BLOCK_SIZE);
+    BOOST_TEST(verifier.Verify());
+
+    UpdateSettings update;
+    update.enabled = true;
+    SignatureGenerator updater(inputPath, signaturePath, 0, ReaderSettings(), HashSettings(), OutputSettings(), VerifySettings(), update);
+    BOOST_TEST(updater.GetBlockSize() == BLOCK_SIZE);
+
+    ReaderSettings mapped;
+    mapped.mode = ReadMode::Mapped;
+    SearchSettings search;
+    search.enabled = true;
+    SignatureGenerator searcher(inputPath, signaturePath, 0, mapped, HashSettings(), OutputSettings(), VerifySettings(), UpdateSettings(),
+        ChunkingSettings(), search);
+    BOOST_TEST(searcher.GetBlockSize() == BLOCK_SIZE);
+    // Last block is complemented with zeroes, so only the full blocks are found
+    BOOST_TEST(searcher.Search() == BLOCKS);
+
+    // Block size given with the signature must still be the one it was generated with
+    BOOST_CHECK_EXCEPTION(SignatureGenerator(inputPath, signaturePath, 2 * BLOCK_SIZE, ReaderSettings(), HashSettings(), OutputSettings(), verify),
+        SignatureGeneratorException, [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+}
+
+BOOST_AUTO_TEST_CASE(RawSignatureUsesDefaultBlockSize)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string signaturePath = directory.File("signature.sig");
+    WriteTestFile(inputPath, RandomData(static_cast<size_t>(3 * MB + 100), 61));
+    GenerateSignature(inputPath, signaturePath, SignatureGenerator::DEFAULT_BLOCK_SIZE, true);
+
+    // Raw signature does not store the block size
+    VerifySettings verify;
+    verify.enabled = true;
+    SignatureGenerator verifier(inputPath, signaturePath, 0, ReaderSettings(), HashSettings(), OutputSettings(), verify);
+    BOOST_TEST(verifier.GetBlockSize() == +SignatureGenerator::DEFAULT_BLOCK_SIZE);
+    BOOST_TEST(verifier.Verify());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,425 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "Pool.h"
+#include "ReorderWindow.h"
+
+namespace {
+
+const unsigned PRODUCERS = 4;
+const unsigned CONSUMERS = 4;
+const uint64_t ITEMS_PER_PRODUCER = 50000;
+
+// Items of a producer are its number in the high bits and a sequence number in the low bits
+uint64_t MakeItem(unsigned producer, uint64_t sequence)
+{
+    return (static_cast<uint64_t>(producer) << 32) | sequence;
+}
+
+// Checks that every item of every producer was taken exactly once and that every consumer
+// saw the items of a producer in the order they were pushed
+void CheckTaken(const std::vector<std::vector<uint64_t>>& taken, unsigned producers, uint64_t itemsPerProducer)
+{
+    std::vector<std::vector<unsigned>> counts(producers, std::vector<unsigned>(static_cast<size_t>(itemsPerProducer), 0));
+    bool ordered = true;
+    bool known = true;
+    for (const auto& items : taken) {
+        std::vector<int64_t> last(producers, -1);
+        for (uint64_t item : items) {
+            const unsigned producer = static_cast<unsigned>(item >> 32);
+            const uint64_t sequence = item & 0xFFFFFFFF;
+            if (producer >= producers || sequence >= itemsPerProducer) {
+                known = false;
+                continue;
+            }
+            if (static_cast<int64_t>(sequence) <= last[producer]) ordered = false;
+            last[producer] = static_cast<int64_t>(sequence);
+            ++counts[producer][static_cast<size_t>(sequence)];
+        }
+    }
+    BOOST_TEST(known);
+    BOOST_TEST(ordered);
+    uint64_t wrong = 0;
+    for (const auto& producerCounts : counts) {
+        for (unsigned count : producerCounts) {
+            if (count != 1) ++wrong;
+        }
+    }
+    BOOST_TEST(wrong == 0u);
+}
+
+// Pushes the items of the producers and pops them by the consumers, which stop when
+// the queue is closed. Returns the items taken by every consumer.
+std::vector<std::vector<uint64_t>> RunQueue(SyncQueue<uint64_t>& queue, unsigned producers, unsigned consumers, uint64_t itemsPerProducer,
+    std::atomic<unsigned>& finishedConsumers)
+{
+    std::vector<std::vector<uint64_t>> taken(consumers);
+    std::vector<std::thread> consumerThreads;
+    for (unsigned c = 0; c < consumers; ++c) {
+        consumerThreads.emplace_back([&, c] {
+            uint64_t item = 0;
+            while (queue.Pop(item)) taken[c].push_back(item);
+            ++finishedConsumers;
+        });
+    }
+
+    std::vector<std::thread> producerThreads;
+    for (unsigned p = 0; p < producers; ++p) {
+        producerThreads.emplace_back([&, p] {
+            for (uint64_t i = 0; i < itemsPerProducer; ++i) queue.Push(MakeItem(p, i));
+        });
+    }
+    for (auto& thread : producerThreads) thread.join();
+    queue.Close();
+    for (auto& thread : consumerThreads) thread.join();
+    return taken;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(RingBufferTests)
+
+BOOST_AUTO_TEST_CASE(CapacityIsRoundedUpToPowerOfTwo)
+{
+    RingBuffer<int> ring;
+    ring.Init(5);
+    for (int i = 0; i < 8; ++i) BOOST_TEST(ring.TryPush(i));
+    BOOST_TEST(!ring.TryPush(8));
+
+    int item = -1;
+    for (int i = 0; i < 8; ++i) {
+        BOOST_TEST(ring.TryPop(item));
+        BOOST_TEST(item == i);
+    }
+    BOOST_TEST(!ring.TryPop(item));
+}
+
+BOOST_AUTO_TEST_CASE(WrapsAroundManyTimes)
+{
+    RingBuffer<uint64_t> ring;
+    ring.Init(4);
+    uint64_t item = 0;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        BOOST_REQUIRE(ring.TryPush(i));
+        BOOST_REQUIRE(ring.TryPush(i + 1000000));
+        BOOST_REQUIRE(ring.TryPop(item));
+        BOOST_REQUIRE(item == i);
+        BOOST_REQUIRE(ring.TryPop(item));
+        BOOST_REQUIRE(item == i + 1000000);
+    }
+    BOOST_TEST(!ring.TryPop(item));
+}
+
+BOOST_AUTO_TEST_CASE(MultipleProducersAndConsumers)
+{
+    // Small ring keeps producers running into a full ring and consumers into an empty one
+    RingBuffer<uint64_t> ring;
+    ring.Init(16);
+    const uint64_t total = PRODUCERS * ITEMS_PER_PRODUCER;
+    std::atomic<uint64_t> popped = 0;
+    std::vector<std::vector<uint64_t>> taken(CONSUMERS);
+
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < CONSUMERS; ++c) {
+        threads.emplace_back([&, c] {
+            uint64_t item = 0;
+            while (popped.load() < total) {
+                if (ring.TryPop(item)) {
+                    taken[c].push_back(item);
+                    ++popped;
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        threads.emplace_back([&, p] {
+            for (uint64_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                while (!ring.TryPush(MakeItem(p, i))) std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    CheckTaken(taken, PRODUCERS, ITEMS_PER_PRODUCER);
+    uint64_t item = 0;
+    BOOST_TEST(!ring.TryPop(item));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(SemaphoreTests)
+
+BOOST_AUTO_TEST_CASE(TryWaitTakesOnlyAvailableCount)
+{
+    Semaphore semaphore(2);
+    BOOST_TEST(semaphore.TryWait());
+    BOOST_TEST(semaphore.TryWait());
+    BOOST_TEST(!semaphore.TryWait());
+    semaphore.Signal(3);
+    for (int i = 0; i < 3; ++i) BOOST_TEST(semaphore.TryWait());
+    BOOST_TEST(!semaphore.TryWait());
+}
+
+BOOST_AUTO_TEST_CASE(EverySignalWakesOneWaiter)
+{
+    // Waiters outnumber the initial count, so most of them go to sleep and are woken by batches of signals
+    const unsigned waiters = 8;
+    const int waitsPerThread = 5000;
+    Semaphore semaphore;
+    std::atomic<int> passed = 0;
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < waiters; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < waitsPerThread; ++i) {
+                semaphore.Wait();
+                ++passed;
+            }
+        });
+    }
+    const int total = waiters * waitsPerThread;
+    for (int signaled = 0; signaled < total;) {
+        const int batch = (std::min)(1 + signaled % 7, total - signaled);
+        semaphore.Signal(batch);
+        signaled += batch;
+        if (signaled % 1000 < 7) std::this_thread::yield();
+    }
+    for (auto& thread : threads) thread.join();
+
+    BOOST_TEST(passed.load() == total);
+    BOOST_TEST(!semaphore.TryWait());
+}
+
+BOOST_AUTO_TEST_CASE(CountLimitsConcurrentHolders)
+{
+    const int limit = 3;
+    Semaphore semaphore(limit);
+    std::atomic<int> holders = 0;
+    std::atomic<int> maxHolders = 0;
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 5000; ++i) {
+                semaphore.Wait();
+                const int current = ++holders;
+                int seen = maxHolders.load();
+                while (current > seen && !maxHolders.compare_exchange_weak(seen, current)) {}
+                if (i % 64 == 0) std::this_thread::yield();
+                --holders;
+                semaphore.Signal();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    BOOST_TEST(maxHolders.load() <= limit);
+    for (int i = 0; i < limit; ++i) BOOST_TEST(semaphore.TryWait());
+    BOOST_TEST(!semaphore.TryWait());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(SyncQueueTests)
+
+BOOST_AUTO_TEST_CASE(TryPopDoesNotWaitForItems)
+{
+    SyncQueue<int> queue;
+    queue.Init(4);
+    int item = 0;
+    BOOST_TEST(!queue.TryPop(item));
+    queue.Push(7);
+    BOOST_TEST(queue.TryPop(item));
+    BOOST_TEST(item == 7);
+    BOOST_TEST(!queue.TryPop(item));
+}
+
+BOOST_AUTO_TEST_CASE(ClosedQueueReturnsRemainingItems)
+{
+    SyncQueue<int> queue;
+    queue.Init(4);
+    queue.Push(1);
+    queue.Push(2);
+    queue.Close();
+
+    int item = 0;
+    BOOST_TEST(queue.Pop(item));
+    BOOST_TEST(item == 1);
+    BOOST_TEST(queue.Pop(item));
+    BOOST_TEST(item == 2);
+    BOOST_TEST(!queue.Pop(item));
+    BOOST_TEST(!queue.Pop(item));
+}
+
+BOOST_AUTO_TEST_CASE(MultipleProducersAndConsumers)
+{
+    // Capacity is far below the number of items, so producers block on a full queue
+    SyncQueue<uint64_t> queue;
+    queue.Init(4);
+    std::atomic<unsigned> finishedConsumers = 0;
+    const auto taken = RunQueue(queue, PRODUCERS, CONSUMERS, ITEMS_PER_PRODUCER, finishedConsumers);
+
+    BOOST_TEST(finishedConsumers.load() == CONSUMERS);
+    CheckTaken(taken, PRODUCERS, ITEMS_PER_PRODUCER);
+}
+
+BOOST_AUTO_TEST_CASE(CloseReleasesSleepingConsumers)
+{
+    SyncQueue<int> queue;
+    queue.Init(4);
+    std::atomic<unsigned> finished = 0;
+
+    std::vector<std::thread> consumers;
+    for (unsigned c = 0; c < CONSUMERS; ++c) {
+        consumers.emplace_back([&] {
+            int item = 0;
+            while (queue.Pop(item)) {}
+            ++finished;
+        });
+    }
+    // Consumers are given time to go to sleep on the empty queue
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.Close();
+    for (auto& thread : consumers) thread.join();
+
+    BOOST_TEST(finished.load() == CONSUMERS);
+}
+
+BOOST_AUTO_TEST_CASE(ReopenedQueueIsReused)
+{
+    // Every round is a complete run of the pipeline after the previous one was closed,
+    // as when several ranges of blocks are processed one after another
+    SyncQueue<uint64_t> queue;
+    queue.Init(8);
+    const uint64_t itemsPerProducer = ITEMS_PER_PRODUCER / 10;
+    for (int round = 0; round < 10; ++round) {
+        std::atomic<unsigned> finishedConsumers = 0;
+        const unsigned consumers = 1 + round % CONSUMERS;
+        const auto taken = RunQueue(queue, PRODUCERS, consumers, itemsPerProducer, finishedConsumers);
+
+        BOOST_TEST(finishedConsumers.load() == consumers);
+        CheckTaken(taken, PRODUCERS, itemsPerProducer);
+        queue.Reopen();
+
+        // Reopened queue is empty and open, so it neither returns an item nor reports the end
+        uint64_t item = 0;
+        BOOST_TEST(!queue.TryPop(item));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(ReorderWindowTests)
+
+BOOST_AUTO_TEST_CASE(ItemsPutOutOfOrderAreTakenInOrder)
+{
+    // Producers take numbers from a shared counter and finish them in any order,
+    // the window is small, so they also wait for the consumer to free slots
+    const uint64_t items = 100000;
+    ReorderWindow<uint64_t> window;
+    window.Init(8);
+    std::atomic<uint64_t> next = 0;
+
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&, p] {
+            for (uint64_t number = next++; number < items; number = next++) {
+                if ((number + p) % 5 == 0) std::this_thread::yield();
+                window.Put(number, number * 3 + 1);
+            }
+        });
+    }
+    uint64_t wrong = 0;
+    for (uint64_t number = 0; number < items; ++number) {
+        if (window.Take(number) != number * 3 + 1) ++wrong;
+    }
+    for (auto& thread : producers) thread.join();
+
+    BOOST_TEST(wrong == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(StartsFromTheFirstItem)
+{
+    ReorderWindow<int> window;
+    window.Init(4, 10);
+    BOOST_TEST(window.IsSlotFree(10));
+    BOOST_TEST(window.IsSlotFree(13));
+    BOOST_TEST(!window.IsSlotFree(14));
+
+    window.Put(11, 2);
+    window.Put(10, 1);
+    BOOST_TEST(!window.IsSlotFree(10));
+    BOOST_TEST(window.Take(10) == 1);
+    BOOST_TEST(window.IsSlotFree(14));
+    BOOST_TEST(window.Take(11) == 2);
+}
+
+BOOST_AUTO_TEST_CASE(CloseReleasesWaitingThreads)
+{
+    ReorderWindow<int> window;
+    window.Init(2);
+    std::atomic<int> released = 0;
+
+    // Item 5 waits for its slot, which is taken by item 1 that is never put,
+    // and the consumer waits for item 0, which is never put either
+    std::thread producer([&] {
+        window.Put(5, 5);
+        ++released;
+    });
+    std::thread slotWaiter([&] {
+        window.WaitSlot(7);
+        ++released;
+    });
+    std::thread consumer([&] {
+        window.Take(0);
+        ++released;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_TEST(released.load() == 0);
+
+    window.Close();
+    producer.join();
+    slotWaiter.join();
+    consumer.join();
+    BOOST_TEST(released.load() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(ResetWindowIsReused)
+{
+    // Verification closes the window at the first mismatch, the next run resets it to its first item
+    ReorderWindow<uint64_t> window;
+    window.Init(4);
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t first = round * 1000;
+        window.Reset(first);
+        const uint64_t items = 5000;
+        const uint64_t stopAt = (round % 2 == 0) ? items : items / 2;
+        std::atomic<uint64_t> next = first;
+
+        std::vector<std::thread> producers;
+        for (unsigned p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&] {
+                for (uint64_t number = next++; number < first + items; number = next++) {
+                    window.Put(number, number);
+                }
+            });
+        }
+        uint64_t wrong = 0;
+        for (uint64_t number = first; number < first + stopAt; ++number) {
+            if (window.Take(number) != number) ++wrong;
+        }
+        // Producers blocked ahead of the consumer are released by closing the window
+        window.Close();
+        for (auto& thread : producers) thread.join();
+
+        BOOST_TEST(wrong == 0u);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "SignatureGenerator.h"
+#include "TestFiles.h"
+
+namespace {
+
+const uint64_t BLOCK_SIZE = 64 * KB;
+const uint64_t BLOCKS = 48;
+const uint64_t READABLE_BLOCKS = 10;    // Blocks left in the input file when it is cut under the generator
+
+bool HasErrorCode(SignatureGeneratorException exception, int error)
+{
+    return exception.ErrorCode() == error;
+}
+
+// Input file cut after the generator took its size, so reading the blocks after the cut fails
+void CutInput(const std::string& inputPath)
+{
+    boost::filesystem::resize_file(inputPath, READABLE_BLOCKS * BLOCK_SIZE);
+}
+
+// Generates the signature of the input file that is cut under the generator, the run must fail
+void GenerateFromCutInput(const std::string& inputPath, const std::string& outputPath, ReadMode mode, const OutputSettings& output = OutputSettings())
+{
+    ReaderSettings reader;
+    reader.mode = mode;
+    SignatureGenerator generator(inputPath, outputPath, BLOCK_SIZE, reader, HashSettings(), output);
+    CutInput(inputPath);
+    BOOST_CHECK_EXCEPTION(generator.Generate(), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_READ_FAULT); });
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ReadFailureTests)
+
+BOOST_AUTO_TEST_CASE(FailedReadStopsGeneration)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string outputPath = directory.File("output.sig");
+
+    for (ReadMode mode : { ReadMode::Stream, ReadMode::Positional, ReadMode::Async }) {
+        BOOST_TEST_CONTEXT("read mode " << static_cast<int>(mode)) {
+            WriteTestFile(inputPath, RandomData(static_cast<size_t>(BLOCKS * BLOCK_SIZE), 40));
+            GenerateFromCutInput(inputPath, outputPath, mode);
+            // Hashes of the blocks that were not read are not written
+            BOOST_TEST(boost::filesystem::file_size(outputPath) <= SignatureHeader::RECORDS_ALIGNMENT + READABLE_BLOCKS * CSHA256::OUTPUT_SIZE);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FailedReadKeepsUpdatedSignature)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    const std::string signaturePath = directory.File("signature.sig");
+
+    for (ReadMode mode : { ReadMode::Stream, ReadMode::Positional, ReadMode::Async }) {
+        BOOST_TEST_CONTEXT("read mode " << static_cast<int>(mode)) {
+            WriteTestFile(inputPath, RandomData(static_cast<size_t>(BLOCKS * BLOCK_SIZE), 41));
+            SignatureGenerator(inputPath, signaturePath, BLOCK_SIZE).Generate();
+            const auto previous = ReadTestFile(signaturePath);
+
+            // Every block of the input file changes, so all of them are hashed again
+            WriteTestFile(inputPath, RandomData(static_cast<size_t>(BLOCKS * BLOCK_SIZE), 42));
+            {
+                ReaderSettings reader;
+                reader.mode = mode;
+                UpdateSettings update;
+                update.enabled = true;
+                SignatureGenerator generator(inputPath, signaturePath, BLOCK_SIZE, reader, HashSettings(), OutputSettings(), VerifySettings(), update);
+                CutInput(inputPath);
+                BOOST_CHECK_EXCEPTION(generator.Update(), SignatureGeneratorException,
+                    [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_READ_FAULT); });
+            }
+
+            // Records of the blocks that were not read keep their previous hashes
+            const auto updated = ReadTestFile(signaturePath);
+            BOOST_REQUIRE_EQUAL(updated.size(), previous.size());
+            const size_t unread = static_cast<size_t>(SignatureHeader::RECORDS_ALIGNMENT + READABLE_BLOCKS * CSHA256::OUTPUT_SIZE);
+            BOOST_TEST(std::vector<unsigned char>(updated.begin() + unread, updated.end()) ==
+                std::vector<unsigned char>(previous.begin() + unread, previous.end()), boost::test_tools::per_element());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,35 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "SignatureGenerator.h"
+#include "TestFiles.h"
+
+namespace {
+
+bool HasErrorCode(SignatureGeneratorException exception, int error)
+{
+    return exception.ErrorCode() == error;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ReaderTests)
+
+BOOST_AUTO_TEST_CASE(DirectReadingIsRejectedInOtherModes)
+{
+    TemporaryDirectory directory;
+    const std::string inputPath = directory.File("input.bin");
+    WriteTestFile(inputPath, RandomData(static_cast<size_t>(256 * KB), 50));
+
+    // Stream mode is the default one, so the direct flag alone must be rejected as well
+    for (ReadMode mode : { ReadMode::Stream, ReadMode::Mapped }) {
+        BOOST_TEST_CONTEXT("read mode " << static_cast<int>(mode)) {
+            ReaderSettings reader;
+            reader.mode = mode;
+            reader.directIo = true;
+            BOOST_CHECK_EXCEPTION(SignatureGenerator(inputPath, directory.File("output.sig"), 64 * KB, reader), SignatureGeneratorException,
+                [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
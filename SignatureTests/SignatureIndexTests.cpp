@@ -0,0 +1,293 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "SignatureIndex.h"
+#include "SignatureGenerator.h"
+#include "TestFiles.h"
+
+namespace {
+
+typedef std::vector<unsigned char> Key;
+
+// Layout of a signature crafted from the keys of its records
+struct Layout
+{
+    const char* name;
+    HashAlgorithm algorithm;
+    size_t keySize;
+    uint8_t flags;
+    bool header;        // Raw SHA-256 signatures have no header
+    uint8_t version;
+};
+
+const Layout RAW_SHA256 = { "raw sha256", HashAlgorithm::Sha256, 32, 0, false, SignatureHeader::VERSION };
+const Layout SHA256_V2 = { "sha256", HashAlgorithm::Sha256, 32, 0, true, SignatureHeader::VERSION };
+const Layout CRC32C_V2 = { "crc32c", HashAlgorithm::CRC32C, 4, 0, true, SignatureHeader::VERSION };
+const Layout CRC32C_CHUNKS = { "crc32c chunks", HashAlgorithm::CRC32C, 4, SignatureHeader::FLAG_CHUNKS, true, SignatureHeader::VERSION };
+const Layout XXH64_WEAK_V1 = { "xxh64 with weak checksums v1", HashAlgorithm::XXH64, 8, SignatureHeader::FLAG_WEAK_CHECKSUM, true, SignatureHeader::VERSION_1 };
+
+// Signature file of records with the given keys. Weak checksums and chunk offsets differ
+// from record to record, so only the keys can make records equal.
+std::vector<unsigned char> MakeSignature(const Layout& layout, const std::vector<Key>& keys)
+{
+    const size_t weakSize = (layout.flags & SignatureHeader::FLAG_WEAK_CHECKSUM) ? WeakChecksum::SIZE : 0;
+    SignatureHeader header = { layout.algorithm, static_cast<uint8_t>(layout.keySize + weakSize), layout.flags, layout.version };
+    header.blockSize = 4 * KB;
+    header.inputSize = keys.size() * header.blockSize;
+    header.records = keys.size();
+
+    std::vector<unsigned char> signature;
+    if (layout.header) {
+        signature.resize(static_cast<size_t>(header.RecordsOffset()), 0);
+        header.Serialize(signature.data());
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(keys[i].size(), layout.keySize);
+        if (layout.flags & SignatureHeader::FLAG_CHUNKS) {
+            unsigned char prefix[SignatureHeader::CHUNK_RECORD_PREFIX];
+            WriteLE64(prefix, i * header.blockSize);
+            WriteLE32(prefix + 8, static_cast<uint32_t>(header.blockSize));
+            signature.insert(signature.end(), prefix, prefix + sizeof(prefix));
+        }
+        signature.insert(signature.end(), keys[i].begin(), keys[i].end());
+        if (weakSize > 0) {
+            unsigned char weak[WeakChecksum::SIZE];
+            WriteLE32(weak, static_cast<uint32_t>(i * 2654435761u));
+            signature.insert(signature.end(), weak, weak + sizeof(weak));
+        }
+    }
+    return signature;
+}
+
+// Distinct keys of the given size, the leading bytes of them are replaced with the given prefix
+std::vector<Key> DistinctKeys(size_t count, size_t keySize, uint64_t seed, const Key& prefix = Key())
+{
+    const auto data = RandomData(count * keySize, seed);
+    std::vector<Key> keys;
+    for (size_t i = 0; i < count; ++i) {
+        Key key(data.begin() + i * keySize, data.begin() + (i + 1) * keySize);
+        std::copy(prefix.begin(), prefix.end(), key.begin());
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// Records of every key in the order of the signature
+std::map<Key, std::vector<uint64_t>> RecordsOf(const std::vector<Key>& keys)
+{
+    std::map<Key, std::vector<uint64_t>> records;
+    for (size_t i = 0; i < keys.size(); ++i) records[keys[i]].push_back(i);
+    return records;
+}
+
+uint64_t BuildIndex(const TemporaryDirectory& directory, const Layout& layout, const std::vector<Key>& keys)
+{
+    WriteTestFile(directory.File("signature.sig"), MakeSignature(layout, keys));
+    return SignatureIndex::Build(directory.File("signature.sig"), directory.File("signature.idx"));
+}
+
+// Checks that the index finds exactly the records of every key and nothing for the absent ones
+void CheckIndex(const SignatureIndex& index, const Layout& layout, const std::vector<Key>& keys, const std::vector<Key>& absent)
+{
+    const auto expected = RecordsOf(keys);
+    BOOST_TEST((index.Header().algorithm == layout.algorithm));
+    BOOST_TEST(index.Header().keySize == layout.keySize);
+    BOOST_TEST(index.Header().records == keys.size());
+    BOOST_TEST(index.Header().distinct == expected.size());
+
+    uint64_t mismatches = 0;
+    for (const auto& key : expected) {
+        const SignatureIndex::Records records = index.Find(key.first.data());
+        std::vector<uint64_t> found;
+        for (uint64_t i = 0; i < records.count; ++i) found.push_back(records[i]);
+        if (found != key.second) ++mismatches;
+    }
+    BOOST_TEST(mismatches == 0u);
+
+    uint64_t foundAbsent = 0;
+    for (const auto& key : absent) {
+        if (expected.count(key) == 0 && index.Find(key.data()).count != 0) ++foundAbsent;
+    }
+    BOOST_TEST(foundAbsent == 0u);
+}
+
+// Keys that are not in the signature: random ones and ones differing from its keys in a single byte
+std::vector<Key> AbsentKeys(const std::vector<Key>& keys, size_t keySize, uint64_t seed)
+{
+    std::vector<Key> absent = DistinctKeys(1000, keySize, seed);
+    for (size_t i = 0; i < keys.size(); i += 7) {
+        Key key = keys[i];
+        key[i % keySize] ^= 0x01;
+        absent.push_back(key);
+    }
+    return absent;
+}
+
+bool HasErrorCode(SignatureGeneratorException exception, int error)
+{
+    return exception.ErrorCode() == error;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(SignatureIndexTests)
+
+BOOST_AUTO_TEST_CASE(DuplicateKeysFindAllTheirRecords)
+{
+    for (const Layout& layout : { RAW_SHA256, SHA256_V2, CRC32C_V2, CRC32C_CHUNKS, XXH64_WEAK_V1 }) {
+        BOOST_TEST_CONTEXT(layout.name) {
+            // Keys repeat from once up to a hundred times at scattered records
+            const auto distinct = DistinctKeys(5000, layout.keySize, 24);
+            std::vector<Key> keys;
+            for (size_t i = 0; i < distinct.size(); ++i) {
+                const size_t repeats = (i % 10 == 0) ? 1 + i % 100 : 1 + i % 3;
+                keys.insert(keys.end(), repeats, distinct[i]);
+            }
+            const auto order = RandomData(keys.size(), 25);
+            for (size_t i = keys.size() - 1; i > 0; --i) std::swap(keys[i], keys[(order[i] * 65537 + i * 31) % (i + 1)]);
+
+            TemporaryDirectory directory;
+            BOOST_TEST(BuildIndex(directory, layout, keys) == distinct.size());
+            const SignatureIndex index(directory.File("signature.idx"));
+            CheckIndex(index, layout, keys, AbsentKeys(distinct, layout.keySize, 26));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SkewedKeysSpillAndWrapAround)
+{
+    for (const Layout& layout : { SHA256_V2, CRC32C_V2 }) {
+        BOOST_TEST_CONTEXT(layout.name) {
+            // Keys crowd at the end of the table, so they spill out of the range of the last
+            // partition and wrap around to the start, where other crowded keys are
+            std::vector<Key> keys;
+            for (const Key& prefix : { Key(3, 0xFF), Key(3, 0x00), Key(2, 0x80), Key() }) {
+                const auto cluster = DistinctKeys(3000, layout.keySize, 27 + prefix.size() + (prefix.empty() ? 0 : prefix[0]), prefix);
+                keys.insert(keys.end(), cluster.begin(), cluster.end());
+            }
+            // Keys with the same leading eight bytes
+            const auto same = DistinctKeys(500, layout.keySize, 28, Key((std::min)(layout.keySize - 1, static_cast<size_t>(8)), 0xFF));
+            keys.insert(keys.end(), same.begin(), same.end());
+            keys.insert(keys.end(), same.begin(), same.begin() + 100);
+
+            TemporaryDirectory directory;
+            BuildIndex(directory, layout, keys);
+            const SignatureIndex index(directory.File("signature.idx"));
+            CheckIndex(index, layout, keys, AbsentKeys(keys, layout.keySize, 29));
+
+            // Keys of the last slots are found in the first half of the table
+            const auto file = ReadTestFile(directory.File("signature.idx"));
+            const size_t slotSize = SignatureIndexHeader::SLOT_PREFIX + layout.keySize;
+            const uint64_t half = 1ULL << (index.Header().slotBits - 1);
+            bool wrapped = false;
+            for (uint64_t slot = 0; slot < half && !wrapped; ++slot) {
+                const unsigned char* entry = file.data() + SignatureIndexHeader::SIZE + slot * slotSize;
+                wrapped = ReadLE64(entry) != 0 && entry[SignatureIndexHeader::SLOT_PREFIX] == 0xFF;
+            }
+            BOOST_TEST(wrapped);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(KeysShorterThanPrefix)
+{
+    // CRC32C keys are shorter than the 8-byte prefix of the slot numbers, and keys that
+    // differ only in the last byte land in adjacent or the same slots
+    std::vector<Key> keys;
+    for (unsigned i = 0; i < 256; ++i) {
+        keys.push_back({ 0x12, 0x34, 0x56, static_cast<unsigned char>(i) });
+        keys.push_back({ static_cast<unsigned char>(i), 0x00, 0x00, 0x00 });
+    }
+    const auto random = DistinctKeys(20000, 4, 30);
+    keys.insert(keys.end(), random.begin(), random.end());
+    keys.insert(keys.end(), random.begin(), random.begin() + 2000);
+
+    for (const Layout& layout : { CRC32C_V2, CRC32C_CHUNKS }) {
+        BOOST_TEST_CONTEXT(layout.name) {
+            TemporaryDirectory directory;
+            BuildIndex(directory, layout, keys);
+            const SignatureIndex index(directory.File("signature.idx"));
+            CheckIndex(index, layout, keys, AbsentKeys(keys, layout.keySize, 31));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(JoinWritesSharedRecords)
+{
+    const Layout& layout = SHA256_V2;
+    const auto indexed = DistinctKeys(3000, layout.keySize, 32);
+    std::vector<Key> indexKeys(indexed.begin(), indexed.end());
+    indexKeys.insert(indexKeys.end(), indexed.begin(), indexed.begin() + 500);
+    std::reverse(indexKeys.begin(), indexKeys.end());
+    const auto expected = RecordsOf(indexKeys);
+
+    // Other signature has some of the keys, some of them several times, and keys of its own
+    std::vector<Key> otherKeys = DistinctKeys(2000, layout.keySize, 33);
+    for (size_t i = 0; i < indexed.size(); i += 3) otherKeys.insert(otherKeys.begin() + (i * 7) % otherKeys.size(), indexed[i]);
+    otherKeys.insert(otherKeys.end(), indexed.begin(), indexed.begin() + 10);
+
+    TemporaryDirectory directory;
+    BuildIndex(directory, layout, indexKeys);
+    const SignatureIndex index(directory.File("signature.idx"));
+    WriteTestFile(directory.File("other.sig"), MakeSignature(RAW_SHA256, otherKeys));
+
+    std::vector<unsigned char> pairs;
+    for (uint64_t r = 0; r < otherKeys.size(); ++r) {
+        const auto records = expected.find(otherKeys[r]);
+        if (records == expected.end()) continue;
+        unsigned char match[16];
+        WriteLE64(match, r);
+        WriteLE64(match + 8, records->second.front());
+        pairs.insert(pairs.end(), match, match + sizeof(match));
+    }
+    BOOST_REQUIRE(!pairs.empty());
+
+    BOOST_TEST(index.Join(directory.File("other.sig"), directory.File("matches.bin")) == pairs.size() / 16);
+    BOOST_TEST(ReadTestFile(directory.File("matches.bin")) == pairs, boost::test_tools::per_element());
+    BOOST_TEST(index.Join(directory.File("other.sig"), "") == pairs.size() / 16);
+
+    // Hashes of other algorithms are not comparable
+    WriteTestFile(directory.File("crc.sig"), MakeSignature(CRC32C_V2, DistinctKeys(10, CRC32C_V2.keySize, 34)));
+    BOOST_CHECK_EXCEPTION(index.Join(directory.File("crc.sig"), ""), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); });
+}
+
+BOOST_AUTO_TEST_CASE(DamagedFilesAreRejected)
+{
+    TemporaryDirectory directory;
+    const auto keys = DistinctKeys(100, 32, 35);
+    const auto build = [&](const std::vector<unsigned char>& signature) {
+        WriteTestFile(directory.File("damaged.sig"), signature);
+        SignatureIndex::Build(directory.File("damaged.sig"), directory.File("damaged.idx"));
+    };
+    const auto invalid = [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_INVALID_DATA); };
+
+    BOOST_CHECK_EXCEPTION(SignatureIndex::Build(directory.File("missing.sig"), directory.File("missing.idx")), SignatureGeneratorException,
+        [](SignatureGeneratorException e) { return HasErrorCode(e, ERROR_FILE_NOT_FOUND); });
+    BOOST_CHECK_EXCEPTION(build(std::vector<unsigned char>()), SignatureGeneratorException, invalid);
+
+    // Raw records are cut, or the number of records in the header does not match them
+    auto signature = MakeSignature(RAW_SHA256, keys);
+    signature.pop_back();
+    BOOST_CHECK_EXCEPTION(build(signature), SignatureGeneratorException, invalid);
+    signature = MakeSignature(SHA256_V2, keys);
+    signature.resize(signature.size() - 32);
+    BOOST_CHECK_EXCEPTION(build(signature), SignatureGeneratorException, invalid);
+    signature = MakeSignature(SHA256_V2, keys);
+    signature.resize(static_cast<size_t>(SignatureHeader::RECORDS_ALIGNMENT));
+    BOOST_CHECK_EXCEPTION(build(signature), SignatureGeneratorException, invalid);
+
+    // Index files that are cut or are not indexes
+    BuildIndex(directory, SHA256_V2, keys);
+    auto index = ReadTestFile(directory.File("signature.idx"));
+    index.pop_back();
+    WriteTestFile(directory.File("damaged.idx"), index);
+    BOOST_CHECK_EXCEPTION(SignatureIndex(directory.File("damaged.idx")), SignatureGeneratorException, invalid);
+    BOOST_CHECK_EXCEPTION(SignatureIndex(directory.File("signature.sig")), SignatureGeneratorException, invalid);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <boost/filesystem.hpp>
+
+// TemporaryDirectory is a unique directory for the files of a test, it is removed with them
+class TemporaryDirectory
+{
+private:
+    boost::filesystem::path path;
+
+public:
+    TemporaryDirectory() {
+        path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("signature-tests-%%%%-%%%%-%%%%");
+        boost::filesystem::create_directories(path);
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    ~TemporaryDirectory() {
+        boost::system::error_code error;
+        boost::filesystem::remove_all(path, error);
+    }
+
+    std::string File(const std::string& name) const {
+        return (path / name).string();
+    }
+};
+
+// Pseudo-random bytes of the given seed, the same on every run
+inline std::vector<unsigned char> RandomData(size_t size, uint64_t seed)
+{
+    std::vector<unsigned char> data(size);
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    for (size_t i = 0; i < size; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = static_cast<unsigned char>(state >> 24);
+    }
+    return data;
+}
+
+inline void WriteTestFile(const std::string& path, const std::vector<unsigned char>& data)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write((const char*)data.data(), data.size());
+}
+
+inline std::vector<unsigned char> ReadTestFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}